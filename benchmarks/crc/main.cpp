@@ -0,0 +1,105 @@
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+std::vector<unsigned char> make_buffer(std::size_t size)
+{
+    std::vector<unsigned char> buffer(size);
+    std::iota(std::begin(buffer), std::end(buffer), 0);
+    return buffer;
+}
+
+template <typename crc_t>
+void run(benchmark::State& state, crc_t&& crc)
+{
+    const auto buffer = make_buffer(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(crc(buffer.data(), buffer.size()));
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+}
+
+static void BM_crc(benchmark::State& state)
+{
+    run(state, [](const unsigned char* b, std::size_t s) { return spacewire::crc(b, s); });
+}
+BENCHMARK(BM_crc)->RangeMultiplier(16)->Range(16, 16 << 20);
+
+static void BM_crc_static(benchmark::State& state)
+{
+    run(state, [](const unsigned char* b, std::size_t s) { return spacewire::static_crc(b, s); });
+}
+BENCHMARK(BM_crc_static)->RangeMultiplier(16)->Range(16, 16 << 20);
+
+static void BM_crc_slice_by_16(benchmark::State& state)
+{
+    run(state,
+        [](const unsigned char* b, std::size_t s)
+        { return spacewire::details::crc::slice_by_16(b, s, 0); });
+}
+BENCHMARK(BM_crc_slice_by_16)->RangeMultiplier(16)->Range(16, 16 << 20);
+
+#ifdef SPACEWIREPP_HAS_CLMUL_CRC
+static void BM_crc_clmul(benchmark::State& state)
+{
+    if (!spacewire::details::crc::has_clmul())
+    {
+        state.SkipWithError("PCLMULQDQ not supported");
+        return;
+    }
+    run(state,
+        [](const unsigned char* b, std::size_t s)
+        { return spacewire::details::crc::clmul(b, s, 0); });
+}
+BENCHMARK(BM_crc_clmul)->RangeMultiplier(16)->Range(64, 16 << 20);
+#endif
+
+static void BM_crc_state_chunks(benchmark::State& state)
+{
+    const auto buffer = make_buffer(1 << 20);
+    const auto chunk = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state)
+    {
+        spacewire::crc_state crc;
+        for (std::size_t offset = 0; offset < buffer.size(); offset += chunk)
+            crc.update(buffer.data() + offset, std::min(chunk, buffer.size() - offset));
+        benchmark::DoNotOptimize(crc.value);
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_crc_state_chunks)->RangeMultiplier(8)->Range(64, 1 << 20);
+
+// Copy out of a packet then CRC, against the fused crc_copy()
+static void BM_memcpy_then_crc(benchmark::State& state)
+{
+    const auto buffer = make_buffer(static_cast<std::size_t>(state.range(0)));
+    std::vector<unsigned char> destination(buffer.size());
+    for (auto _ : state)
+    {
+        std::memcpy(destination.data(), buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(spacewire::crc(buffer.data(), buffer.size()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_memcpy_then_crc)->RangeMultiplier(16)->Range(4096, 64 << 20);
+
+static void BM_crc_copy(benchmark::State& state)
+{
+    const auto buffer = make_buffer(static_cast<std::size_t>(state.range(0)));
+    std::vector<unsigned char> destination(buffer.size());
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            spacewire::crc_copy(destination.data(), buffer.data(), buffer.size()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_crc_copy)->RangeMultiplier(16)->Range(4096, 64 << 20);
+
+BENCHMARK_MAIN();
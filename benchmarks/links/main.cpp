@@ -0,0 +1,103 @@
+#include <SpaceWirePP/udp_link.hpp>
+#include <SpaceWirePP/unix_socket_link.hpp>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct loopback
+{
+    static auto make_pair() { return spacewire::loopback_link::make_pair(); }
+    static void disconnect(spacewire::loopback_link& link) { link.close(); }
+};
+
+struct unix_socket
+{
+    static auto make_pair() { return spacewire::unix_socket_link::make_pair(); }
+    static void disconnect(spacewire::socket_link& link) { link.shutdown(); }
+};
+
+struct udp
+{
+    static auto make_pair() { return spacewire::udp_link::make_pair(8 << 20); }
+    static void disconnect(spacewire::socket_link& link) { link.shutdown(); }
+};
+
+// Batches of packets of range(0) bytes sent with send_packets() and drained with
+// receive_packets() from the same thread, a batch is kept under 64 KiB so it fits in the socket
+// buffers
+template <typename backend>
+static void BM_link_batch_throughput(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const std::size_t batch = std::clamp<std::size_t>((64 << 10) / size, 1, 64);
+    auto links = backend::make_pair();
+    std::vector<unsigned char> packet(size, 0x55);
+    std::vector<spacewire::const_buffer> out(batch, { packet.data(), size });
+    std::vector<unsigned char> storage(batch * size);
+    std::vector<spacewire::mutable_buffer> in;
+    for (std::size_t i = 0; i < batch; i++)
+        in.push_back({ storage.data() + i * size, size });
+    std::vector<std::size_t> sizes(batch);
+    for (auto _ : state)
+    {
+        if (links.first.send_packets(out.data(), batch) != batch)
+            state.SkipWithError("send_packets failed");
+        std::size_t received = 0;
+        while (received < batch)
+        {
+            const auto n = links.second.receive_packets(
+                in.data() + received, sizes.data(), batch - received, 100ms);
+            if (!n || *n == 0)
+            {
+                state.SkipWithError("receive_packets failed");
+                break;
+            }
+            received += *n;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * size);
+}
+BENCHMARK_TEMPLATE(BM_link_batch_throughput, loopback)->Arg(16)->Arg(1024)->Arg(16384);
+BENCHMARK_TEMPLATE(BM_link_batch_throughput, unix_socket)->Arg(16)->Arg(1024)->Arg(16384);
+BENCHMARK_TEMPLATE(BM_link_batch_throughput, udp)->Arg(16)->Arg(1024)->Arg(16384);
+
+// Round trip of one range(0) bytes packet through an echo thread leasing packets
+template <typename backend>
+static void BM_link_round_trip(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    auto links = backend::make_pair();
+    auto& local = links.first;
+    auto& remote = links.second;
+    std::thread echo { [&remote]()
+        {
+            while (true)
+            {
+                auto lease = remote.lease(100ms);
+                if (!lease)
+                    return;
+                if (*lease)
+                    remote.send(lease->data(), lease->size());
+            }
+        } };
+    std::vector<unsigned char> packet(size, 0x55);
+    std::vector<unsigned char> reply(size);
+    for (auto _ : state)
+    {
+        local.send(packet.data(), size);
+        if (local.receive(reply.data(), size, 1000ms) != size)
+            state.SkipWithError("no echo");
+    }
+    state.SetItemsProcessed(state.iterations());
+    backend::disconnect(remote);
+    echo.join();
+}
+BENCHMARK_TEMPLATE(BM_link_round_trip, loopback)->Arg(16)->Arg(1024)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_link_round_trip, unix_socket)->Arg(16)->Arg(1024)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_link_round_trip, udp)->Arg(16)->Arg(1024)->UseRealTime();
+
+BENCHMARK_MAIN();
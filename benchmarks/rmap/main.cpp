@@ -0,0 +1,209 @@
+#include <SpaceWirePP/batch_decode.hpp>
+#include <SpaceWirePP/packet_template.hpp>
+#include <SpaceWirePP/packet_view.hpp>
+#include <SpaceWirePP/rmap.hpp>
+#include <benchmark/benchmark.h>
+#include <numeric>
+#include <vector>
+
+using namespace spacewire::rmap;
+
+namespace
+{
+std::vector<unsigned char> make_buffer(std::size_t size)
+{
+    std::vector<unsigned char> buffer(size);
+    std::iota(std::begin(buffer), std::end(buffer), 0);
+    return buffer;
+}
+
+std::vector<unsigned char> make_write_request(std::size_t size)
+{
+    const auto data = make_buffer(size);
+    std::vector<unsigned char> packet(write_request_buffer_size(size));
+    build_write_request(0xFE, 0, 0x20, 0x40000000, 1, data.data(), size, packet);
+    return packet;
+}
+}
+
+static void BM_build_read_request(benchmark::State& state)
+{
+    std::array<unsigned char, read_request_buffer_size()> buffer;
+    uint16_t tid = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            build_read_request(0xFE, 0, 0x20, 0x40000000, tid++, 256, buffer));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_build_read_request);
+
+static void BM_packet_template_read(benchmark::State& state)
+{
+    static constexpr packet_template<rmap_read_cmd_tag> tmpl { 0xFE, 0, 0x20, 0x40000000, 256 };
+    std::array<unsigned char, read_request_buffer_size()> buffer;
+    uint16_t tid = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(tmpl.build(tid++, buffer.data()));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_packet_template_read);
+
+static void BM_packet_template_read_address(benchmark::State& state)
+{
+    static constexpr packet_template<rmap_read_cmd_tag> tmpl { 0xFE, 0, 0x20, 0, 256 };
+    std::array<unsigned char, read_request_buffer_size()> buffer;
+    uint16_t tid = 0;
+    uint32_t address = 0x40000000;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(tmpl.build(tid++, address, buffer.data()));
+        address += 256;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_packet_template_read_address);
+
+static void BM_build_read_request_allocating(benchmark::State& state)
+{
+    uint16_t tid = 0;
+    for (auto _ : state)
+    {
+        auto packet = build_read_request(0xFE, 0, 0x20, 0x40000000, tid++, 256);
+        benchmark::DoNotOptimize(packet);
+        delete[] packet;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * read_request_buffer_size());
+}
+BENCHMARK(BM_build_read_request_allocating);
+
+static void BM_build_write_request(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto data = make_buffer(size);
+    std::vector<unsigned char> buffer(write_request_buffer_size(size));
+    uint16_t tid = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            build_write_request(0xFE, 0, 0x20, 0x40000000, tid++, data.data(), size, buffer));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_build_write_request)->RangeMultiplier(16)->Range(16, 1 << 20)->Arg((1 << 24) - 1);
+
+static void BM_build_write_request_segments(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto data = make_buffer(size);
+    uint16_t tid = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(build_write_request_segments(
+            0xFE, 0, 0x20, 0x40000000, tid++, data.data(), size));
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * write_request_buffer_size(size));
+}
+BENCHMARK(BM_build_write_request_segments)->RangeMultiplier(16)->Range(16, 1 << 20)->Arg((1 << 24) - 1);
+
+template <typename T>
+static void BM_field_proxy_decode(benchmark::State& state)
+{
+    auto buffer = make_buffer(4096);
+    for (auto _ : state)
+    {
+        for (std::size_t offset = 0; offset < 4092; offset += 4)
+            benchmark::DoNotOptimize(
+                T(spacewire::field_proxy<T, true> { std::as_const(buffer).data() + offset }));
+    }
+    state.SetItemsProcessed(state.iterations() * 1023);
+    state.SetBytesProcessed(state.iterations() * 1023 * sizeof(T));
+}
+BENCHMARK_TEMPLATE(BM_field_proxy_decode, uint16_t);
+BENCHMARK_TEMPLATE(BM_field_proxy_decode, uint32_t);
+BENCHMARK_TEMPLATE(BM_field_proxy_decode, spacewire::uint24_t);
+
+template <typename T>
+static void BM_field_proxy_encode(benchmark::State& state)
+{
+    auto buffer = make_buffer(4096);
+    for (auto _ : state)
+    {
+        for (std::size_t offset = 0; offset < 4092; offset += 4)
+            spacewire::field_proxy<T> { buffer.data() + offset } = T(static_cast<int>(offset));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * 1023);
+    state.SetBytesProcessed(state.iterations() * 1023 * sizeof(T));
+}
+BENCHMARK_TEMPLATE(BM_field_proxy_encode, uint16_t);
+BENCHMARK_TEMPLATE(BM_field_proxy_encode, uint32_t);
+BENCHMARK_TEMPLATE(BM_field_proxy_encode, spacewire::uint24_t);
+
+static void BM_header_crc_valid(benchmark::State& state)
+{
+    const auto packet = make_write_request(16);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(header_crc_valid<rmap_write_cmd_tag>(packet.data()));
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * request_header_size());
+}
+BENCHMARK(BM_header_crc_valid);
+
+static void BM_data_crc_valid(benchmark::State& state)
+{
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto packet = make_write_request(size);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(data_crc_valid<rmap_write_cmd_tag>(packet.data()));
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_data_crc_valid)->RangeMultiplier(16)->Range(16, 1 << 20)->Arg((1 << 24) - 1);
+
+static void BM_packet_view(benchmark::State& state)
+{
+    const auto packet = make_write_request(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(packet_view { packet.data(), packet.size() });
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packet.size());
+}
+BENCHMARK(BM_packet_view)->RangeMultiplier(16)->Range(16, 1 << 20)->Arg((1 << 24) - 1);
+
+static void BM_decode_capture(benchmark::State& state)
+{
+    const auto packet_size = static_cast<std::size_t>(state.range(0));
+    const auto packet = make_write_request(packet_size);
+    std::vector<unsigned char> capture;
+    const std::size_t count = std::max<std::size_t>(1, (16 << 20) / packet.size());
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (int b = 0; b < 4; b++)
+            capture.push_back(static_cast<unsigned char>(packet.size() >> (8 * b)));
+        capture.insert(std::end(capture), std::cbegin(packet), std::cend(packet));
+    }
+    packet_columns columns;
+    columns.reserve(count);
+    for (auto _ : state)
+    {
+        columns.clear();
+        benchmark::DoNotOptimize(decode_capture(capture.data(), capture.size(), columns));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetBytesProcessed(state.iterations() * capture.size());
+}
+BENCHMARK(BM_decode_capture)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK_MAIN();
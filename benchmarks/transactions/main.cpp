@@ -0,0 +1,100 @@
+#include <SpaceWirePP/client.hpp>
+#include <SpaceWirePP/packet_pool.hpp>
+#include <SpaceWirePP/target.hpp>
+#include <SpaceWirePP/transaction_table.hpp>
+#include <SpaceWirePP/transfer.hpp>
+#include <benchmark/benchmark.h>
+#include <thread>
+#include <vector>
+
+using namespace spacewire::rmap;
+
+static void BM_packet_pool_acquire_release(benchmark::State& state)
+{
+    spacewire::packet_pool pool { 64, 1024 };
+    for (auto _ : state)
+    {
+        auto handle = pool.acquire();
+        benchmark::DoNotOptimize(handle.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_packet_pool_acquire_release);
+
+static void BM_transaction_table_acquire_complete(benchmark::State& state)
+{
+    transaction_table<int> table { static_cast<std::size_t>(state.range(0)) };
+    const auto deadline = transaction_table<int>::clock::now() + std::chrono::hours { 1 };
+    for (auto _ : state)
+    {
+        auto tid = table.acquire(1, deadline);
+        benchmark::DoNotOptimize(table.complete(*tid));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_transaction_table_acquire_complete)->Arg(64)->Arg(65536);
+
+static void BM_target_handle_read(benchmark::State& state)
+{
+    const auto size = static_cast<uint32_t>(state.range(0));
+    std::vector<unsigned char> memory(size);
+    target t;
+    t.map_memory(0, memory.data(), memory.size());
+    std::array<unsigned char, read_request_buffer_size()> command;
+    build_read_request(0xFE, 0, 0x20, 0, 1, size, command);
+    std::vector<unsigned char> reply(read_reply_buffer_size(size));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            t.handle(command.data(), command.size(), reply.data(), reply.size()));
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_target_handle_read)->RangeMultiplier(16)->Range(4, 1 << 20);
+
+static void BM_target_handle_write(benchmark::State& state)
+{
+    const auto size = static_cast<uint32_t>(state.range(0));
+    std::vector<unsigned char> memory(size);
+    target t;
+    t.map_memory(0, memory.data(), memory.size());
+    std::vector<unsigned char> command(write_request_buffer_size(size));
+    build_write_request(0xFE, 0, 0x20, 0, 1, memory.data(), size, command);
+    std::array<unsigned char, write_reply_size()> reply;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            t.handle(command.data(), command.size(), reply.data(), reply.size()));
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_target_handle_write)->RangeMultiplier(16)->Range(4, 1 << 20);
+
+// Round trips through client, loopback link and target, args are chunk size and window
+static void BM_loopback_read_region(benchmark::State& state)
+{
+    const std::size_t region_size = 4 << 20;
+    std::vector<unsigned char> memory(region_size);
+    target t;
+    t.map_memory(0, memory.data(), memory.size());
+    auto [initiator, target_link] = spacewire::loopback_link::make_pair();
+    std::thread server { [&, &target_link = target_link]() { t.serve(target_link); } };
+    {
+        client c { initiator };
+        std::vector<unsigned char> destination(region_size);
+        const transfer_config config { static_cast<std::size_t>(state.range(0)),
+            static_cast<std::size_t>(state.range(1)), 0 };
+        for (auto _ : state)
+        {
+            if (!read_region(c, 0, destination.data(), destination.size(), config).ok())
+                state.SkipWithError("read_region failed");
+        }
+        state.SetItemsProcessed(state.iterations() * (region_size / config.chunk_size));
+        state.SetBytesProcessed(state.iterations() * region_size);
+    }
+    target_link.close();
+    server.join();
+}
+BENCHMARK(BM_loopback_read_region)
+    ->ArgsProduct({ { 1024, 16384, 262144 }, { 1, 8, 64 } })
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
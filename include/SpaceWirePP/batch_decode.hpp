@@ -0,0 +1,286 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "packet_view.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPACEWIREPP_HAS_SSSE3_DECODE 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Batch decoding of RMAP captures into structure of arrays.
+ *
+ * A capture is a contiguous sequence of records, each record being a 4 bytes little endian
+ * packet size followed by the packet bytes.
+ *
+ * Decoding runs in two passes over blocks of packets:
+ *  - a scalar pass walks the records, classifies packets, checks bounds and CRCs and copies
+ *    each header in a 16 bytes staging slot with the reply address stripped, so every packet
+ *    kind has its fields at fixed offsets,
+ *  - a column pass extracts the big endian TID, address and data length of each staged header
+ *    with a single byte shuffle (SSSE3 when available) and appends them to the columns.
+ */
+
+namespace spacewire::rmap
+{
+
+struct packet_columns
+{
+    std::vector<std::size_t> offset;
+    std::vector<std::size_t> size;
+    std::vector<packet_kind> kind;
+    std::vector<unsigned char> packet_type;
+    // key for commands, status for replies
+    std::vector<unsigned char> status;
+    std::vector<uint16_t> transaction_id;
+    std::vector<uint32_t> address;
+    std::vector<uint32_t> data_length;
+    std::vector<bool> header_crc_valid;
+    std::vector<bool> data_crc_valid;
+
+    std::size_t count() const { return std::size(offset); }
+
+    void reserve(std::size_t n)
+    {
+        offset.reserve(n);
+        size.reserve(n);
+        kind.reserve(n);
+        packet_type.reserve(n);
+        status.reserve(n);
+        transaction_id.reserve(n);
+        address.reserve(n);
+        data_length.reserve(n);
+        header_crc_valid.reserve(n);
+        data_crc_valid.reserve(n);
+    }
+
+    void clear()
+    {
+        offset.clear();
+        size.clear();
+        kind.clear();
+        packet_type.clear();
+        status.clear();
+        transaction_id.clear();
+        address.clear();
+        data_length.clear();
+        header_crc_valid.clear();
+        data_crc_valid.clear();
+    }
+};
+
+namespace details::batch
+{
+    static constexpr std::size_t block_size = 256;
+    static constexpr unsigned char z = 0x80;
+
+    // Byte shuffle per packet kind, output lanes are:
+    // [ TID (LE) | 0 | 0 | address (LE) | data length (LE) | 0 | status | type | 0 | 0 ]
+    alignas(16) static constexpr unsigned char shuffles[7][16] = {
+        // invalid
+        { z, z, z, z, z, z, z, z, z, z, z, z, 3, 2, z, z },
+        // read_command
+        { 6, 5, z, z, 11, 10, 9, 8, 14, 13, 12, z, 3, 2, z, z },
+        // write_command
+        { 6, 5, z, z, 11, 10, 9, 8, 14, 13, 12, z, 3, 2, z, z },
+        // read_reply
+        { 6, 5, z, z, z, z, z, z, 10, 9, 8, z, 3, 2, z, z },
+        // write_reply
+        { 6, 5, z, z, z, z, z, z, z, z, z, z, 3, 2, z, z },
+        // rmw_command
+        { 6, 5, z, z, 11, 10, 9, 8, 14, 13, 12, z, 3, 2, z, z },
+        // rmw_reply
+        { 6, 5, z, z, z, z, z, z, 10, 9, 8, z, 3, 2, z, z },
+    };
+
+    struct staged_header
+    {
+        alignas(16) unsigned char bytes[16];
+    };
+
+    inline void extract_scalar(const staged_header& header, packet_kind kind, uint32_t* lanes)
+    {
+        const auto& shuffle = shuffles[static_cast<std::size_t>(kind)];
+        unsigned char out[16];
+        for (std::size_t i = 0; i < 16; i++)
+            out[i] = (shuffle[i] & z) ? 0 : header.bytes[shuffle[i]];
+        std::memcpy(lanes, out, 16);
+    }
+
+#ifdef SPACEWIREPP_HAS_SSSE3_DECODE
+    __attribute__((target("ssse3"))) inline void extract_ssse3(const staged_header* headers,
+        const packet_kind* kinds, std::size_t count, uint32_t* lanes)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const __m128i header
+                = _mm_load_si128(reinterpret_cast<const __m128i*>(headers[i].bytes));
+            const __m128i shuffle = _mm_load_si128(
+                reinterpret_cast<const __m128i*>(shuffles[static_cast<std::size_t>(kinds[i])]));
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(lanes + 4 * i), _mm_shuffle_epi8(header, shuffle));
+        }
+    }
+
+    inline bool has_ssse3()
+    {
+        static const bool supported = __builtin_cpu_supports("ssse3");
+        return supported;
+    }
+#endif
+
+    inline void extract(
+        const staged_header* headers, const packet_kind* kinds, std::size_t count, uint32_t* lanes)
+    {
+#ifdef SPACEWIREPP_HAS_SSSE3_DECODE
+        if (has_ssse3())
+            return extract_ssse3(headers, kinds, count, lanes);
+#endif
+        for (std::size_t i = 0; i < count; i++)
+            extract_scalar(headers[i], kinds[i], lanes + 4 * i);
+    }
+
+    // Classifies the packet, copies its header to the staging slot and checks CRCs.
+    inline void stage(const unsigned char* packet, std::size_t size, staged_header& header,
+        packet_kind& kind, bool& header_crc_ok, bool& data_crc_ok)
+    {
+        std::memset(header.bytes, 0, sizeof(header.bytes));
+        std::memcpy(header.bytes, packet, std::min<std::size_t>(size, 4));
+        kind = packet_kind::invalid;
+        header_crc_ok = false;
+        data_crc_ok = false;
+        if (size < 8 || packet[1] != static_cast<unsigned char>(protocol_id_t::SPW_PROTO_ID_RMAP))
+            return;
+        kind = classify_packet_type(packet[2]);
+        std::size_t header_size = 0;
+        switch (kind)
+        {
+            case packet_kind::read_command:
+            case packet_kind::write_command:
+            case packet_kind::rmw_command:
+            {
+                const std::size_t reply_address_size = 4 * (packet[2] & 0b11);
+                header_size = 16 + reply_address_size;
+                if (size < header_size)
+                    break;
+                std::memcpy(header.bytes + 4, packet + 4 + reply_address_size, 12);
+                header_crc_ok = spacewire::crc(packet, header_size - 1) == packet[header_size - 1];
+                break;
+            }
+            case packet_kind::read_reply:
+            case packet_kind::rmw_reply:
+                header_size = 12;
+                if (size < header_size)
+                    break;
+                std::memcpy(header.bytes, packet, header_size);
+                header_crc_ok = spacewire::crc(packet, 11) == packet[11];
+                break;
+            case packet_kind::write_reply:
+                header_size = 8;
+                std::memcpy(header.bytes, packet, header_size);
+                header_crc_ok = spacewire::crc(packet, 7) == packet[7];
+                data_crc_ok = header_crc_ok && size == header_size;
+                return;
+            default:
+                return;
+        }
+        if (!header_crc_ok)
+            return;
+        if (kind == packet_kind::read_command)
+        {
+            data_crc_ok = size == header_size;
+            return;
+        }
+        const bool is_reply = kind == packet_kind::read_reply || kind == packet_kind::rmw_reply;
+        const unsigned char* length = header.bytes + (is_reply ? 8 : 12);
+        const std::size_t data_length
+            = (std::size_t { length[0] } << 16) | (std::size_t { length[1] } << 8) | length[2];
+        if (size == header_size + data_length + 1)
+            data_crc_ok = spacewire::crc(packet + header_size, data_length) == packet[size - 1];
+    }
+}
+
+/*
+ * Decodes every complete record of capture and appends them to columns.
+ * Returns the number of bytes consumed, which is less than capture_size when the capture ends
+ * with an incomplete record.
+ * data_crc_valid is also false when the packet size disagrees with its data length field.
+ */
+inline std::size_t decode_capture(
+    const unsigned char* capture, std::size_t capture_size, packet_columns& columns)
+{
+    using namespace details::batch;
+    std::array<staged_header, block_size> headers;
+    std::array<packet_kind, block_size> kinds;
+    alignas(16) std::array<uint32_t, 4 * block_size> lanes;
+    std::size_t position = 0;
+    bool done = false;
+    while (!done)
+    {
+        std::size_t count = 0;
+        for (; count < block_size; count++)
+        {
+            if (capture_size - position < 4)
+            {
+                done = true;
+                break;
+            }
+            uint32_t size = 0;
+            for (int i = 3; i >= 0; i--)
+                size = (size << 8) | capture[position + i];
+            if (capture_size - position - 4 < size)
+            {
+                done = true;
+                break;
+            }
+            const unsigned char* packet = capture + position + 4;
+            bool header_crc_ok, data_crc_ok;
+            stage(packet, size, headers[count], kinds[count], header_crc_ok, data_crc_ok);
+            columns.offset.push_back(position + 4);
+            columns.size.push_back(size);
+            columns.kind.push_back(kinds[count]);
+            columns.header_crc_valid.push_back(header_crc_ok);
+            columns.data_crc_valid.push_back(data_crc_ok);
+            position += 4 + size;
+        }
+        extract(headers.data(), kinds.data(), count, lanes.data());
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const uint32_t* packet_lanes = lanes.data() + 4 * i;
+            columns.transaction_id.push_back(static_cast<uint16_t>(packet_lanes[0]));
+            columns.address.push_back(packet_lanes[1]);
+            columns.data_length.push_back(packet_lanes[2]);
+            columns.status.push_back(static_cast<unsigned char>(packet_lanes[3]));
+            columns.packet_type.push_back(static_cast<unsigned char>(packet_lanes[3] >> 8));
+        }
+    }
+    return position;
+}
+
+}
@@ -0,0 +1,555 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "mapped_memory.hpp"
+#include "packet_view.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Capture files of timestamped SpaceWire packets.
+ *
+ * A capture is made of two files:
+ *  - the packet stream, a 16 bytes file header ("SPWPCAP", version) followed by records made
+ *    of a 4 bytes little endian packet size, an 8 bytes little endian timestamp in nanoseconds
+ *    and the packet bytes,
+ *  - a sidecar index (stream path + ".idx") holding one fixed size entry per record in record
+ *    order followed by two permutations of the entries, sorted by transaction identifier and by
+ *    command address. The index is written in host byte order, it is a cache that can always
+ *    be rebuilt from the stream.
+ *
+ * Timestamps must be non decreasing so that the entries are also sorted by time, every lookup
+ * is then a binary search over the mapped index.
+ */
+
+namespace spacewire::rmap
+{
+
+struct capture_index_entry
+{
+    // offset of the packet bytes in the stream file
+    uint64_t offset;
+    int64_t timestamp;
+    // 40 bits address, only meaningful for commands
+    uint64_t address;
+    uint32_t size;
+    uint32_t data_length;
+    uint16_t transaction_id;
+    packet_kind kind;
+    bool valid;
+    unsigned char packet_type;
+    unsigned char reserved[3];
+};
+static_assert(sizeof(capture_index_entry) == 40);
+
+struct capture_record
+{
+    std::chrono::nanoseconds timestamp;
+    const unsigned char* data;
+    std::size_t size;
+
+    packet_view view() const noexcept { return packet_view { data, size }; }
+};
+
+namespace details::capture
+{
+    static constexpr char stream_magic[8] = { 'S', 'P', 'W', 'P', 'C', 'A', 'P', 0 };
+    static constexpr char index_magic[8] = { 'S', 'P', 'W', 'P', 'I', 'D', 'X', 0 };
+    static constexpr uint32_t version = 1;
+    static constexpr std::size_t stream_header_size = 16;
+    static constexpr std::size_t record_header_size = 12;
+
+    struct index_header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entry_size;
+        uint64_t count;
+        uint64_t address_count;
+        // stream size covered by the index, a mismatch means the index is stale
+        uint64_t stream_size;
+    };
+
+    inline std::string index_path(const char* path) { return std::string { path } + ".idx"; }
+
+    inline void encode_le(uint64_t value, std::size_t size, unsigned char* out)
+    {
+        for (std::size_t i = 0; i < size; i++)
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    inline uint64_t decode_le(const unsigned char* in, std::size_t size)
+    {
+        uint64_t value = 0;
+        for (std::size_t i = size; i > 0; i--)
+            value = (value << 8) | in[i - 1];
+        return value;
+    }
+
+    inline void encode_stream_header(unsigned char* out)
+    {
+        std::memcpy(out, stream_magic, 8);
+        encode_le(version, 4, out + 8);
+        encode_le(0, 4, out + 12);
+    }
+
+    inline capture_index_entry make_entry(
+        uint64_t offset, int64_t timestamp, const unsigned char* packet, std::size_t size)
+    {
+        const packet_view view { packet, size };
+        capture_index_entry entry {};
+        entry.offset = offset;
+        entry.timestamp = timestamp;
+        entry.size = static_cast<uint32_t>(size);
+        entry.kind = view.kind();
+        entry.valid = view.valid();
+        if (view.kind() != packet_kind::invalid)
+        {
+            entry.packet_type = view.packet_type();
+            entry.transaction_id = view.transaction_id();
+            entry.data_length = view.data_length();
+            if (view.is_command())
+                entry.address = view.full_address();
+        }
+        return entry;
+    }
+
+    /*
+     * Lays out the index: header, entries, TID permutation then address permutation.
+     * Permutations are stable so records sharing a key stay in time order.
+     */
+    inline std::vector<unsigned char> serialize_index(
+        const std::vector<capture_index_entry>& entries, uint64_t stream_size)
+    {
+        const std::size_t count = std::size(entries);
+        std::vector<uint32_t> by_tid(count);
+        std::vector<uint32_t> by_address;
+        by_address.reserve(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            by_tid[i] = static_cast<uint32_t>(i);
+            const packet_kind kind = entries[i].kind;
+            if (kind == packet_kind::read_command || kind == packet_kind::write_command
+                || kind == packet_kind::rmw_command)
+                by_address.push_back(static_cast<uint32_t>(i));
+        }
+        std::stable_sort(std::begin(by_tid), std::end(by_tid), [&](uint32_t a, uint32_t b)
+            { return entries[a].transaction_id < entries[b].transaction_id; });
+        std::stable_sort(std::begin(by_address), std::end(by_address),
+            [&](uint32_t a, uint32_t b) { return entries[a].address < entries[b].address; });
+
+        index_header header {};
+        std::memcpy(header.magic, index_magic, 8);
+        header.version = version;
+        header.entry_size = sizeof(capture_index_entry);
+        header.count = count;
+        header.address_count = std::size(by_address);
+        header.stream_size = stream_size;
+
+        std::vector<unsigned char> index(sizeof(header) + count * sizeof(capture_index_entry)
+            + (count + std::size(by_address)) * sizeof(uint32_t));
+        unsigned char* out = index.data();
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        std::memcpy(out, entries.data(), count * sizeof(capture_index_entry));
+        out += count * sizeof(capture_index_entry);
+        std::memcpy(out, by_tid.data(), count * sizeof(uint32_t));
+        out += count * sizeof(uint32_t);
+        std::memcpy(out, by_address.data(), std::size(by_address) * sizeof(uint32_t));
+        return index;
+    }
+
+    // Returns the entries of every complete record, a truncated last record is ignored
+    inline std::vector<capture_index_entry> scan_stream(
+        const unsigned char* stream, std::size_t size)
+    {
+        std::vector<capture_index_entry> entries;
+        std::size_t position = stream_header_size;
+        while (size - position >= record_header_size)
+        {
+            const std::size_t packet_size = decode_le(stream + position, 4);
+            const int64_t timestamp = static_cast<int64_t>(decode_le(stream + position + 4, 8));
+            const std::size_t offset = position + record_header_size;
+            if (size - offset < packet_size)
+                break;
+            entries.push_back(make_entry(offset, timestamp, stream + offset, packet_size));
+            position = offset + packet_size;
+        }
+        return entries;
+    }
+
+    inline bool write_all(int fd, const unsigned char* data, std::size_t size)
+    {
+        while (size)
+        {
+            const ssize_t written = ::write(fd, data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    inline bool write_file(const std::string& path, const std::vector<unsigned char>& content)
+    {
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        const bool ok = write_all(fd, content.data(), std::size(content));
+        return (::close(fd) == 0) && ok;
+    }
+}
+
+/*
+ * Buffered capture writer, records are appended to a user space buffer flushed with a single
+ * write once full. Index entries are kept in memory and the sidecar index is written by close().
+ */
+class capture_writer
+{
+public:
+    static constexpr std::size_t default_buffer_size = 1 << 20;
+
+    capture_writer() = default;
+    ~capture_writer() { close(); }
+
+    capture_writer(capture_writer&& other) noexcept
+            : m_path { std::move(other.m_path) }
+            , m_fd { std::exchange(other.m_fd, -1) }
+            , m_buffer { std::move(other.m_buffer) }
+            , m_buffered { std::exchange(other.m_buffered, 0) }
+            , m_position { std::exchange(other.m_position, 0) }
+            , m_last_timestamp { other.m_last_timestamp }
+            , m_entries { std::move(other.m_entries) }
+    {
+    }
+    capture_writer& operator=(capture_writer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_path = std::move(other.m_path);
+            m_fd = std::exchange(other.m_fd, -1);
+            m_buffer = std::move(other.m_buffer);
+            m_buffered = std::exchange(other.m_buffered, 0);
+            m_position = std::exchange(other.m_position, 0);
+            m_last_timestamp = other.m_last_timestamp;
+            m_entries = std::move(other.m_entries);
+        }
+        return *this;
+    }
+
+    /*
+     * Creates or truncates the capture at path, returns a closed writer on failure.
+     */
+    static capture_writer create(const char* path, std::size_t buffer_size = default_buffer_size)
+    {
+        capture_writer writer;
+        writer.m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (writer.m_fd < 0)
+            return writer;
+        writer.m_path = path;
+        writer.m_buffer.resize(
+            std::max(buffer_size, details::capture::stream_header_size));
+        details::capture::encode_stream_header(writer.m_buffer.data());
+        writer.m_buffered = details::capture::stream_header_size;
+        writer.m_position = details::capture::stream_header_size;
+        return writer;
+    }
+
+    bool is_open() const { return m_fd >= 0; }
+    explicit operator bool() const { return is_open(); }
+    std::size_t count() const { return std::size(m_entries); }
+
+    /*
+     * Appends one packet, fails when timestamp is older than the previous one, when the packet
+     * does not fit the 32 bits size field or on I/O error.
+     */
+    bool append(std::chrono::nanoseconds timestamp, const unsigned char* packet, std::size_t size)
+    {
+        using namespace details::capture;
+        if (m_fd < 0 || timestamp.count() < m_last_timestamp || size > UINT32_MAX)
+            return false;
+        unsigned char header[record_header_size];
+        encode_le(size, 4, header);
+        encode_le(static_cast<uint64_t>(timestamp.count()), 8, header + 4);
+        const uint64_t offset = m_position + record_header_size;
+        if (std::size(m_buffer) - m_buffered < record_header_size + size)
+        {
+            if (!flush())
+                return false;
+        }
+        if (std::size(m_buffer) - m_buffered >= record_header_size + size)
+        {
+            std::memcpy(m_buffer.data() + m_buffered, header, record_header_size);
+            std::memcpy(m_buffer.data() + m_buffered + record_header_size, packet, size);
+            m_buffered += record_header_size + size;
+        }
+        else if (!write_all(m_fd, header, record_header_size) || !write_all(m_fd, packet, size))
+            return false;
+        m_entries.push_back(make_entry(offset, timestamp.count(), packet, size));
+        m_position = offset + size;
+        m_last_timestamp = timestamp.count();
+        return true;
+    }
+
+    bool flush()
+    {
+        if (m_fd < 0)
+            return false;
+        const bool ok = details::capture::write_all(m_fd, m_buffer.data(), m_buffered);
+        m_buffered = 0;
+        return ok;
+    }
+
+    /*
+     * Flushes the stream and writes the sidecar index, returns false if any of them failed.
+     */
+    bool close()
+    {
+        if (m_fd < 0)
+            return false;
+        bool ok = flush();
+        ok = (::close(std::exchange(m_fd, -1)) == 0) && ok;
+        if (ok)
+            ok = details::capture::write_file(details::capture::index_path(m_path.c_str()),
+                details::capture::serialize_index(m_entries, m_position));
+        m_entries.clear();
+        return ok;
+    }
+
+private:
+    std::string m_path;
+    int m_fd = -1;
+    std::vector<unsigned char> m_buffer;
+    std::size_t m_buffered = 0;
+    uint64_t m_position = 0;
+    int64_t m_last_timestamp = INT64_MIN;
+    std::vector<capture_index_entry> m_entries;
+};
+
+/*
+ * Memory mapped capture reader, records are zero copy views into the mapping.
+ * The sidecar index is mapped too; when it is missing or stale, for example after a crash of
+ * the writer, it is rebuilt in memory by scanning the stream.
+ */
+class capture_reader
+{
+public:
+    // Contiguous range of record indices, in key then time order
+    struct index_range
+    {
+        const uint32_t* first = nullptr;
+        const uint32_t* last = nullptr;
+
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+        std::size_t size() const { return static_cast<std::size_t>(last - first); }
+        bool empty() const { return first == last; }
+    };
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = capture_record;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = capture_record;
+
+        iterator(const capture_reader* reader, std::size_t index)
+                : m_reader { reader }, m_index { index }
+        {
+        }
+        capture_record operator*() const { return (*m_reader)[m_index]; }
+        iterator& operator++()
+        {
+            m_index++;
+            return *this;
+        }
+        iterator operator++(int) { return iterator { m_reader, m_index++ }; }
+        iterator& operator+=(difference_type n)
+        {
+            m_index += n;
+            return *this;
+        }
+        iterator operator+(difference_type n) const { return iterator { m_reader, m_index + n }; }
+        difference_type operator-(const iterator& other) const
+        {
+            return static_cast<difference_type>(m_index - other.m_index);
+        }
+        bool operator==(const iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+        std::size_t index() const { return m_index; }
+
+    private:
+        const capture_reader* m_reader;
+        std::size_t m_index;
+    };
+
+    capture_reader() = default;
+
+    /*
+     * Opens the capture at path, returns an empty reader when the stream cannot be mapped or
+     * has an invalid header.
+     */
+    static capture_reader open(const char* path)
+    {
+        using namespace details::capture;
+        capture_reader reader;
+        reader.m_stream = mapped_memory::read_only(path);
+        if (!reader.m_stream || reader.m_stream.size() < stream_header_size
+            || std::memcmp(reader.m_stream.data(), stream_magic, 8) != 0
+            || decode_le(reader.m_stream.data() + 8, 4) != version)
+            return {};
+        reader.m_index = mapped_memory::read_only(index_path(path).c_str());
+        if (!reader.m_index || !reader.load_index(reader.m_index.data(), reader.m_index.size()))
+        {
+            reader.m_index = {};
+            reader.m_owned_index = serialize_index(
+                scan_stream(reader.m_stream.data(), reader.m_stream.size()),
+                reader.m_stream.size());
+            reader.load_index(reader.m_owned_index.data(), std::size(reader.m_owned_index));
+        }
+        return reader;
+    }
+
+    explicit operator bool() const { return static_cast<bool>(m_stream); }
+    // false when the sidecar index had to be rebuilt in memory
+    bool index_mapped() const { return static_cast<bool>(m_index); }
+
+    std::size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+
+    const capture_index_entry& entry(std::size_t index) const { return m_entries[index]; }
+
+    capture_record operator[](std::size_t index) const
+    {
+        const capture_index_entry& e = m_entries[index];
+        return { std::chrono::nanoseconds { e.timestamp }, m_stream.data() + e.offset, e.size };
+    }
+
+    iterator begin() const { return iterator { this, 0 }; }
+    iterator end() const { return iterator { this, m_count }; }
+
+    /*
+     * Index of the first record not older than timestamp, size() if there is none.
+     */
+    std::size_t seek(std::chrono::nanoseconds timestamp) const
+    {
+        const auto position = std::lower_bound(m_entries, m_entries + m_count, timestamp.count(),
+            [](const capture_index_entry& e, int64_t t) { return e.timestamp < t; });
+        return static_cast<std::size_t>(position - m_entries);
+    }
+
+    /*
+     * Records, commands and replies, carrying transaction_id.
+     */
+    index_range find_transaction(uint16_t transaction_id) const
+    {
+        const auto [first, last] = std::equal_range(m_by_tid, m_by_tid + m_count,
+            transaction_id, tid_compare { m_entries });
+        return { first, last };
+    }
+
+    /*
+     * Commands whose 40 bits address is in [first, last), sorted by address.
+     */
+    index_range find_address(uint64_t first, uint64_t last) const
+    {
+        const auto end = m_by_address + m_address_count;
+        const auto compare = [this](uint32_t index, uint64_t address)
+        { return m_entries[index].address < address; };
+        return { std::lower_bound(m_by_address, end, first, compare),
+            std::lower_bound(m_by_address, end, last, compare) };
+    }
+
+    /*
+     * Hints the kernel about upcoming stream accesses, replays should use sequential.
+     */
+    void advise(bool sequential) const { m_stream.advise(sequential); }
+
+private:
+    struct tid_compare
+    {
+        const capture_index_entry* entries;
+        bool operator()(uint32_t index, uint16_t tid) const
+        {
+            return entries[index].transaction_id < tid;
+        }
+        bool operator()(uint16_t tid, uint32_t index) const
+        {
+            return tid < entries[index].transaction_id;
+        }
+    };
+
+    bool load_index(const unsigned char* index, std::size_t size)
+    {
+        using namespace details::capture;
+        index_header header;
+        if (size < sizeof(header))
+            return false;
+        std::memcpy(&header, index, sizeof(header));
+        if (std::memcmp(header.magic, index_magic, 8) != 0 || header.version != version
+            || header.entry_size != sizeof(capture_index_entry)
+            || header.stream_size != m_stream.size() || header.address_count > header.count
+            || (size - sizeof(header)) / (sizeof(capture_index_entry) + sizeof(uint32_t))
+                < header.count
+            || size - sizeof(header) - header.count * sizeof(capture_index_entry)
+                < (header.count + header.address_count) * sizeof(uint32_t))
+            return false;
+        m_count = header.count;
+        m_address_count = header.address_count;
+        m_entries = reinterpret_cast<const capture_index_entry*>(index + sizeof(header));
+        m_by_tid = reinterpret_cast<const uint32_t*>(m_entries + m_count);
+        m_by_address = m_by_tid + m_count;
+        return true;
+    }
+
+    mapped_memory m_stream;
+    mapped_memory m_index;
+    std::vector<unsigned char> m_owned_index;
+    const capture_index_entry* m_entries = nullptr;
+    const uint32_t* m_by_tid = nullptr;
+    const uint32_t* m_by_address = nullptr;
+    std::size_t m_count = 0;
+    std::size_t m_address_count = 0;
+};
+
+}
+#endif
@@ -0,0 +1,258 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "SpaceWire.hpp"
+#include "instrumentation.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * CCSDS packet transfer protocol (ECSS-E-ST-50-53C).
+ *
+ * A SpaceWire packet carries one CCSDS space packet behind a 4 bytes header:
+ * [ target logical address | protocol identifier (2) | reserved (0) | user application ]
+ * The space packet starts with a 6 bytes big endian primary header:
+ * [ version:3 | type:1 | secondary header flag:1 | APID:11 ]
+ * [ sequence flags:2 | sequence count:14 ]
+ * [ packet data length ] which is the size of the packet data field minus one.
+ */
+
+namespace spacewire::ccsds
+{
+
+enum class packet_type_t : unsigned char
+{
+    telemetry = 0,
+    telecommand = 1
+};
+
+enum class sequence_flags_t : unsigned char
+{
+    continuation = 0b00,
+    first = 0b01,
+    last = 0b10,
+    unsegmented = 0b11
+};
+
+enum class packet_error : unsigned char
+{
+    none,
+    too_short,
+    not_ccsds,
+    early_eop,
+    too_much_data
+};
+
+inline constexpr std::size_t spacewire_header_size()
+{
+    return 4;
+}
+inline constexpr std::size_t primary_header_size()
+{
+    return 6;
+}
+inline constexpr std::size_t header_size()
+{
+    return spacewire_header_size() + primary_header_size();
+}
+inline constexpr std::size_t packet_buffer_size(std::size_t data_size)
+{
+    return header_size() + data_size;
+}
+
+namespace fields
+{
+    inline unsigned char& reserved(unsigned char* packet) { return packet[2]; }
+    inline const unsigned char& reserved(const unsigned char* packet) { return packet[2]; }
+
+    inline unsigned char& user_application(unsigned char* packet) { return packet[3]; }
+    inline const unsigned char& user_application(const unsigned char* packet)
+    {
+        return packet[3];
+    }
+
+    inline constexpr unsigned char version(const unsigned char* packet) { return packet[4] >> 5; }
+
+    inline constexpr packet_type_t packet_type(const unsigned char* packet)
+    {
+        return static_cast<packet_type_t>((packet[4] >> 4) & 1);
+    }
+
+    inline constexpr bool secondary_header(const unsigned char* packet)
+    {
+        return packet[4] & 0b00001000;
+    }
+
+    inline constexpr uint16_t apid(const unsigned char* packet)
+    {
+        return static_cast<uint16_t>(((packet[4] & 0b111) << 8) | packet[5]);
+    }
+
+    inline constexpr sequence_flags_t sequence_flags(const unsigned char* packet)
+    {
+        return static_cast<sequence_flags_t>(packet[6] >> 6);
+    }
+
+    inline constexpr uint16_t sequence_count(const unsigned char* packet)
+    {
+        return static_cast<uint16_t>(((packet[6] & 0b00111111) << 8) | packet[7]);
+    }
+
+    inline field_proxy<uint16_t> packet_data_length(unsigned char* packet)
+    {
+        return { packet + 8 };
+    }
+    inline field_proxy<uint16_t, true> packet_data_length(const unsigned char* packet)
+    {
+        return { packet + 8 };
+    }
+
+    inline unsigned char* data(unsigned char* packet) { return packet + header_size(); }
+    inline const unsigned char* data(const unsigned char* packet) { return packet + header_size(); }
+}
+
+inline bool is_ccsds(const unsigned char* packet)
+{
+    return spacewire::fields::protocol_identifier(packet)
+        == spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS;
+}
+
+/*
+ * Builds a version 0 space packet, buffer must be packet_buffer_size(data_size) bytes long.
+ * The packet data field cannot be empty, data_size must be in [1, 65536].
+ * Returns the packet size.
+ */
+inline std::size_t build_packet(unsigned char target_logical_address,
+    unsigned char user_application, packet_type_t type, bool secondary_header, uint16_t apid,
+    sequence_flags_t sequence_flags, uint16_t sequence_count, const unsigned char* data,
+    std::size_t data_size, unsigned char* buffer)
+{
+    spacewire::fields::destination_logical_address(buffer) = target_logical_address;
+    spacewire::fields::protocol_identifier(buffer) = protocol_id_t::SPW_PROTO_ID_CCSDS;
+    fields::reserved(buffer) = 0;
+    fields::user_application(buffer) = user_application;
+    buffer[4] = static_cast<unsigned char>((static_cast<unsigned char>(type) << 4)
+        | (secondary_header ? 0b00001000 : 0) | ((apid >> 8) & 0b111));
+    buffer[5] = static_cast<unsigned char>(apid);
+    buffer[6] = static_cast<unsigned char>(
+        (static_cast<unsigned char>(sequence_flags) << 6) | ((sequence_count >> 8) & 0b00111111));
+    buffer[7] = static_cast<unsigned char>(sequence_count);
+    fields::packet_data_length(buffer) = static_cast<uint16_t>(data_size - 1);
+    std::memcpy(fields::data(buffer), data, data_size);
+    instrumentation::packet_built(packet_buffer_size(data_size));
+    return packet_buffer_size(data_size);
+}
+
+/*
+ * Validating, non owning view of a CCSDS packet carried over SpaceWire.
+ * The constructor checks the protocol identifier and the packet size against the packet data
+ * length field, decoded fields are stored as plain values.
+ * The reserved byte and the version number are not checked, ECSS-E-ST-50-53C asks targets to
+ * ignore them.
+ */
+class packet_view
+{
+public:
+    packet_view() = default;
+    packet_view(const unsigned char* packet, std::size_t size) noexcept
+            : m_packet { packet }, m_size { size }
+    {
+        decode();
+        instrumentation::packet_parsed(m_size, false, false);
+    }
+
+    packet_error error() const noexcept { return m_error; }
+    bool valid() const noexcept { return m_error == packet_error::none; }
+    explicit operator bool() const noexcept { return valid(); }
+
+    const unsigned char* packet() const noexcept { return m_packet; }
+    std::size_t size() const noexcept { return m_size; }
+    // the space packet, SpaceWire header excluded
+    const unsigned char* space_packet() const noexcept
+    {
+        return m_packet + spacewire_header_size();
+    }
+    std::size_t space_packet_size() const noexcept { return m_data_size + primary_header_size(); }
+
+    unsigned char target_logical_address() const noexcept { return m_target; }
+    unsigned char user_application() const noexcept { return m_user_application; }
+    unsigned char version() const noexcept { return m_version; }
+    packet_type_t packet_type() const noexcept { return m_packet_type; }
+    bool is_telemetry() const noexcept { return m_packet_type == packet_type_t::telemetry; }
+    bool is_telecommand() const noexcept { return m_packet_type == packet_type_t::telecommand; }
+    bool secondary_header() const noexcept { return m_secondary_header; }
+    uint16_t apid() const noexcept { return m_apid; }
+    bool is_idle() const noexcept { return m_apid == 0x7FF; }
+    sequence_flags_t sequence_flags() const noexcept { return m_sequence_flags; }
+    uint16_t sequence_count() const noexcept { return m_sequence_count; }
+
+    // packet data field, secondary header included
+    const unsigned char* data() const noexcept { return m_packet + header_size(); }
+    std::size_t data_size() const noexcept { return m_data_size; }
+
+private:
+    void decode() noexcept
+    {
+        const unsigned char* p = m_packet;
+        if (m_size < header_size() + 1)
+        {
+            m_error = packet_error::too_short;
+            return;
+        }
+        if (!is_ccsds(p))
+        {
+            m_error = packet_error::not_ccsds;
+            return;
+        }
+        m_target = p[0];
+        m_user_application = fields::user_application(p);
+        m_version = fields::version(p);
+        m_packet_type = fields::packet_type(p);
+        m_secondary_header = fields::secondary_header(p);
+        m_apid = fields::apid(p);
+        m_sequence_flags = fields::sequence_flags(p);
+        m_sequence_count = fields::sequence_count(p);
+        m_data_size = std::size_t { static_cast<uint16_t>(fields::packet_data_length(p)) } + 1;
+        if (m_size < header_size() + m_data_size)
+            m_error = packet_error::early_eop;
+        else if (m_size > header_size() + m_data_size)
+            m_error = packet_error::too_much_data;
+        else
+            m_error = packet_error::none;
+    }
+
+    const unsigned char* m_packet = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_data_size = 0;
+    uint16_t m_apid = 0;
+    uint16_t m_sequence_count = 0;
+    packet_error m_error = packet_error::too_short;
+    packet_type_t m_packet_type = packet_type_t::telemetry;
+    sequence_flags_t m_sequence_flags = sequence_flags_t::unsegmented;
+    unsigned char m_target = 0;
+    unsigned char m_user_application = 0;
+    unsigned char m_version = 0;
+    bool m_secondary_header = false;
+};
+
+}
@@ -0,0 +1,436 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "link.hpp"
+#include "packet_view.hpp"
+#include "rmap.hpp"
+#include "transaction_table.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace spacewire::rmap
+{
+
+enum class transaction_error : unsigned char
+{
+    none,
+    timeout,
+    link_error,
+    invalid_reply,
+    cancelled
+};
+
+struct write_reply
+{
+    transaction_error error;
+    status_t status;
+
+    bool ok() const { return error == transaction_error::none && status == status_t::success; }
+};
+
+/*
+ * data points into the client receive buffer and is only valid during the callback, except for
+ * read_into() where it is the destination.
+ */
+struct read_reply
+{
+    transaction_error error;
+    status_t status;
+    const unsigned char* data;
+    std::size_t size;
+
+    bool ok() const { return error == transaction_error::none && status == status_t::success; }
+};
+
+struct read_result
+{
+    transaction_error error;
+    status_t status;
+    std::vector<unsigned char> data;
+
+    bool ok() const { return error == transaction_error::none && status == status_t::success; }
+};
+
+struct client_config
+{
+    unsigned char target_logical_address = 0xFE;
+    unsigned char target_key = 0;
+    unsigned char initiator_logical_address = 0xFE;
+    // maximum number of outstanding transactions
+    std::size_t window = 64;
+    std::chrono::milliseconds timeout { 1000 };
+    // receive thread wake up period, also the timeout detection granularity
+    std::chrono::milliseconds poll_interval { 10 };
+    std::size_t receive_buffer_size = (1 << 24) + 16;
+    // read_into() replies of at least this many bytes are received straight into their
+    // destination on links that can peek, smaller ones are copied out of the receive buffer
+    std::size_t direct_receive_threshold = 4096;
+};
+
+/*
+ * Asynchronous RMAP initiator over a link.
+ *
+ * Requests can be issued from any thread, up to config.window transactions are kept in flight,
+ * issuing more blocks until a reply or a timeout frees a transaction identifier.
+ * A receive thread owned by the client parses replies, matches them with their transaction and
+ * runs the completion callback, callbacks must therefore be short and must not block.
+ *
+ * read_into() gives each read its own destination: the reply data is copied there while its CRC
+ * is checked, or received straight into it when the link can peek at the reply header, so bulk
+ * reads touch their payload once.
+ *
+ * The link must outlive the client.
+ */
+class client
+{
+    using clock = std::chrono::steady_clock;
+    using completion_t = std::function<void(const packet_view*, transaction_error)>;
+
+    struct pending_transaction
+    {
+        completion_t completion;
+        // read_into() destination
+        unsigned char* destination = nullptr;
+        uint32_t length = 0;
+        bool direct = false;
+    };
+
+public:
+    explicit client(spacewire::link& link, client_config config = {})
+            : m_link { link }
+            , m_config { config }
+            , m_transactions { config.window }
+            , m_round_trips { m_transactions.capacity() }
+            , m_receive_buffer(config.receive_buffer_size)
+            , m_receive_thread { &client::receive_loop, this }
+    {
+    }
+
+    ~client()
+    {
+        m_stop = true;
+        m_receive_thread.join();
+    }
+
+    client(const client&) = delete;
+    client& operator=(const client&) = delete;
+
+    const client_config& config() const { return m_config; }
+    std::size_t in_flight() const { return m_transactions.in_flight(); }
+
+    template <typename callback_t>
+    void read(uint32_t address, uint32_t length, callback_t&& callback)
+    {
+        submit(
+            [this, address, length](uint16_t tid, spacewire::link& link)
+            {
+                std::array<unsigned char, read_request_buffer_size()> packet;
+                build_read_request(m_config.target_logical_address, m_config.target_key,
+                    m_config.initiator_logical_address, address, tid, length, packet);
+                return link.send(std::data(packet), std::size(packet));
+            },
+            [length, callback = std::forward<callback_t>(callback)](
+                const packet_view* reply, transaction_error error)
+            {
+                if (reply && reply->kind() != packet_kind::read_reply)
+                    error = transaction_error::invalid_reply;
+                if (reply && error == transaction_error::none && reply->data_length() > length)
+                    error = transaction_error::invalid_reply;
+                if (reply && error == transaction_error::none)
+                    callback(read_reply { error, reply->status(), reply->data(),
+                        reply->data_length() });
+                else
+                    callback(read_reply { error,
+                        reply ? reply->status() : status_t::general_error, nullptr, 0 });
+            });
+    }
+
+    /*
+     * Reads into destination, which must stay valid until the callback runs. The reply data
+     * pointer is destination.
+     */
+    template <typename callback_t>
+    void read_into(
+        uint32_t address, unsigned char* destination, uint32_t length, callback_t&& callback)
+    {
+        const bool direct = length >= m_config.direct_receive_threshold && m_link.can_peek();
+        if (direct)
+            m_direct_reads.fetch_add(1, std::memory_order_relaxed);
+        submit(
+            [this, address, length](uint16_t tid, spacewire::link& link)
+            {
+                std::array<unsigned char, read_request_buffer_size()> packet;
+                build_read_request(m_config.target_logical_address, m_config.target_key,
+                    m_config.initiator_logical_address, address, tid, length, packet);
+                return link.send(std::data(packet), std::size(packet));
+            },
+            pending_transaction {
+                [this, destination, length, direct,
+                    callback = std::forward<callback_t>(callback)](
+                    const packet_view* reply, transaction_error error)
+                {
+                    if (direct)
+                        m_direct_reads.fetch_sub(1, std::memory_order_relaxed);
+                    if (reply && reply->kind() != packet_kind::read_reply)
+                        error = transaction_error::invalid_reply;
+                    if (reply && error == transaction_error::none
+                        && reply->data_length() > length)
+                        error = transaction_error::invalid_reply;
+                    // replies received by receive_direct() are already in place and checked
+                    if (reply && error == transaction_error::none
+                        && reply->data() != destination && !reply->copy_data(destination))
+                        error = transaction_error::invalid_reply;
+                    if (reply && error == transaction_error::none)
+                        callback(read_reply { error, reply->status(), destination,
+                            reply->data_length() });
+                    else
+                        callback(read_reply { error,
+                            reply ? reply->status() : status_t::general_error, nullptr, 0 });
+                },
+                destination, length, direct });
+    }
+
+    template <typename callback_t>
+    void write(uint32_t address, const unsigned char* data, uint32_t length, callback_t&& callback)
+    {
+        submit(
+            [this, address, data, length](uint16_t tid, spacewire::link& link)
+            {
+                const auto packet = build_write_request_segments(m_config.target_logical_address,
+                    m_config.target_key, m_config.initiator_logical_address, address, tid, data,
+                    length);
+                const const_buffer buffers[] { { std::data(packet.header),
+                                                   std::size(packet.header) },
+                    { packet.payload, packet.payload_size }, { &packet.trailer, 1 } };
+                return link.send(buffers, std::size(buffers));
+            },
+            [callback = std::forward<callback_t>(callback)](
+                const packet_view* reply, transaction_error error)
+            {
+                if (reply && reply->kind() != packet_kind::write_reply)
+                    error = transaction_error::invalid_reply;
+                callback(write_reply { error,
+                    reply ? reply->status() : status_t::general_error });
+            });
+    }
+
+    std::future<read_result> read(uint32_t address, uint32_t length)
+    {
+        struct state
+        {
+            std::promise<read_result> promise;
+            std::vector<unsigned char> data;
+        };
+        auto shared = std::make_shared<state>();
+        shared->data.resize(length);
+        auto future = shared->promise.get_future();
+        read_into(address, shared->data.data(), length,
+            [shared](const read_reply& reply)
+            {
+                shared->data.resize(reply.size);
+                shared->promise.set_value(
+                    read_result { reply.error, reply.status, std::move(shared->data) });
+            });
+        return future;
+    }
+
+    std::future<read_reply> read_into(uint32_t address, unsigned char* destination, uint32_t length)
+    {
+        auto promise = std::make_shared<std::promise<read_reply>>();
+        auto future = promise->get_future();
+        read_into(address, destination, length,
+            [promise](const read_reply& reply) { promise->set_value(reply); });
+        return future;
+    }
+
+    /*
+     * data is sent before returning, it does not need to outlive the call.
+     */
+    std::future<write_reply> write(uint32_t address, const unsigned char* data, uint32_t length)
+    {
+        auto promise = std::make_shared<std::promise<write_reply>>();
+        auto future = promise->get_future();
+        write(address, data, length,
+            [promise](const write_reply& reply) { promise->set_value(reply); });
+        return future;
+    }
+
+private:
+    template <typename send_t>
+    void submit(send_t&& send, completion_t&& completion)
+    {
+        submit(std::forward<send_t>(send), pending_transaction { std::move(completion) });
+    }
+
+    template <typename send_t>
+    void submit(send_t&& send, pending_transaction&& transaction)
+    {
+        std::optional<uint16_t> tid;
+        while (!m_closed && !(tid = m_transactions.acquire(
+                                  std::move(transaction), clock::now() + m_config.timeout)))
+        {
+            std::unique_lock<std::mutex> lock { m_window_mutex };
+            m_window_waiters++;
+            m_window_cv.wait_for(lock, m_config.poll_interval);
+            m_window_waiters--;
+        }
+        // pairs with the fence in receive_loop, either the receive thread sees this
+        // transaction when it flushes, or we see m_closed
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!tid)
+            return transaction.completion(nullptr, transaction_error::link_error);
+        m_round_trips.sent(*tid);
+        if (m_closed || !send(*tid, m_link))
+        {
+            if (auto t = m_transactions.cancel(*tid); t)
+                t->completion(nullptr, transaction_error::link_error);
+        }
+    }
+
+    void release_window()
+    {
+        if (m_window_waiters)
+        {
+            std::lock_guard<std::mutex> lock { m_window_mutex };
+            m_window_cv.notify_all();
+        }
+    }
+
+    void handle(std::size_t size)
+    {
+        if (size > std::size(m_receive_buffer))
+            return;
+        const unsigned char* p = m_receive_buffer.data();
+        // read_into() checks the data CRC while copying the data out
+        const auto pending
+            = size >= 8 ? m_transactions.find(static_cast<uint16_t>((p[5] << 8) | p[6])) : nullptr;
+        if (pending && pending->destination)
+            complete(packet_view { p, size, packet_view::deferred_data_crc });
+        else
+            complete(packet_view { p, size });
+    }
+
+    void complete(const packet_view& reply)
+    {
+        if (!reply.is_reply() || !reply.header_crc_valid()
+            || reply.source_logical_address() != m_config.target_logical_address)
+            return;
+        if (auto transaction = m_transactions.complete(reply.transaction_id()); transaction)
+        {
+            m_round_trips.received(reply.transaction_id());
+            transaction->completion(&reply,
+                reply.valid() ? transaction_error::none : transaction_error::invalid_reply);
+            release_window();
+        }
+    }
+
+    /*
+     * Receives the next packet peeking at its header first, read replies of direct read_into()
+     * transactions are scattered straight into their destination and handled here.
+     * Returns like link::receive() with 0 for handled packets too.
+     */
+    std::optional<std::size_t> receive_direct()
+    {
+        std::array<unsigned char, 12> header;
+        const auto size = m_link.peek(header.data(), header.size(), m_config.poll_interval);
+        if (!size || *size == 0)
+            return size;
+        const unsigned char* h = header.data();
+        const auto receive = [this]()
+        {
+            return m_link.receive(m_receive_buffer.data(), std::size(m_receive_buffer),
+                std::chrono::milliseconds { 0 });
+        };
+        if (*size <= std::size(header) || classify_packet_type(h[2]) != packet_kind::read_reply
+            || h[4] != m_config.target_logical_address || spacewire::crc(h, 11) != h[11])
+            return receive();
+        const auto pending = m_transactions.find(static_cast<uint16_t>((h[5] << 8) | h[6]));
+        const std::size_t data_length = (std::size_t { h[8] } << 16) | (h[9] << 8) | h[10];
+        if (!pending || !pending->direct || data_length > pending->length
+            || *size != std::size(header) + data_length + 1)
+            return receive();
+        unsigned char data_crc = 0;
+        const mutable_buffer pieces[] { { header.data(), std::size(header) },
+            { pending->destination, data_length }, { &data_crc, 1 } };
+        const auto received = m_link.receive_scatter(
+            pieces, std::size(pieces), std::chrono::milliseconds { 0 });
+        if (received && *received == *size)
+            complete(packet_view { header.data(), std::size(header), pending->destination,
+                data_length, data_crc });
+        return received ? std::optional<std::size_t> { 0 } : std::nullopt;
+    }
+
+    void receive_loop()
+    {
+        auto next_sweep = clock::now() + m_config.poll_interval;
+        while (!m_stop)
+        {
+            const auto size = m_direct_reads.load(std::memory_order_relaxed)
+                ? receive_direct()
+                : m_link.receive(
+                    m_receive_buffer.data(), std::size(m_receive_buffer), m_config.poll_interval);
+            if (!size)
+                break;
+            if (*size)
+                handle(*size);
+            if (const auto now = clock::now(); now >= next_sweep)
+            {
+                if (m_transactions.expire(now,
+                        [](uint16_t, pending_transaction transaction)
+                        { transaction.completion(nullptr, transaction_error::timeout); }))
+                    release_window();
+                next_sweep = now + m_config.poll_interval;
+            }
+        }
+        m_closed = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto error = m_stop ? transaction_error::cancelled : transaction_error::link_error;
+        m_transactions.expire(clock::time_point::max(),
+            [error](uint16_t, pending_transaction transaction)
+            { transaction.completion(nullptr, error); });
+        release_window();
+    }
+
+    spacewire::link& m_link;
+    client_config m_config;
+    transaction_table<pending_transaction> m_transactions;
+    instrumentation::round_trip_tracker m_round_trips;
+    std::vector<unsigned char> m_receive_buffer;
+    std::mutex m_window_mutex;
+    std::condition_variable m_window_cv;
+    std::atomic<int> m_window_waiters { 0 };
+    // outstanding direct read_into() transactions, the receive thread peeks while there are some
+    std::atomic<int> m_direct_reads { 0 };
+    std::atomic<bool> m_stop { false };
+    std::atomic<bool> m_closed { false };
+    std::thread m_receive_thread;
+};
+
+}
@@ -0,0 +1,230 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "crc.hpp"
+#include "link.hpp"
+#include "rmap.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace spacewire::rmap
+{
+
+namespace details::batch_crc
+{
+    /*
+     * Writes the CRC of each of the count headers of size bytes right after it.
+     * With a zero initial value the CRC of at most 16 bytes is the xor of one slice table
+     * lookup per byte, so there is no dependency between lookups and headers of consecutive
+     * packets are computed side by side instead of walking a serial byte chain per header.
+     */
+    inline void headers(unsigned char* const* headers, std::size_t count, std::size_t size)
+    {
+        const auto& t = spacewire::details::crc::SliceTables;
+        if (size > spacewire::details::crc::slices)
+        {
+            for (std::size_t i = 0; i < count; i++)
+                headers[i][size] = spacewire::crc(headers[i], size);
+            return;
+        }
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned char c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+            for (std::size_t k = 0; k < size; k++)
+            {
+                const auto& table = t[size - 1 - k];
+                c0 ^= table[headers[i][k]];
+                c1 ^= table[headers[i + 1][k]];
+                c2 ^= table[headers[i + 2][k]];
+                c3 ^= table[headers[i + 3][k]];
+            }
+            headers[i][size] = c0;
+            headers[i + 1][size] = c1;
+            headers[i + 2][size] = c2;
+            headers[i + 3][size] = c3;
+        }
+        for (; i < count; i++)
+        {
+            unsigned char c = 0;
+            for (std::size_t k = 0; k < size; k++)
+                c ^= t[size - 1 - k][headers[i][k]];
+            headers[i][size] = c;
+        }
+    }
+}
+
+/*
+ * Many RMAP commands to the same target laid out back to back in one arena.
+ *
+ * Every command shares the target, key, initiator and route given at construction: they are
+ * encoded once in a prototype header which each add copies before patching the command fields.
+ * Transaction identifiers are assigned sequentially from the one given to reset(), wrapping at
+ * 2^16. Header CRCs are left pending and computed for the whole batch in one pass by seal(),
+ * which send() calls, so the arena must not be modified in between.
+ *
+ * Appending never allocates once the arena and the offset table have grown to the batch size,
+ * so a batch reused across control cycles reaches a steady state without allocation.
+ */
+class command_batch
+{
+public:
+    struct entry
+    {
+        std::size_t offset;
+        std::size_t size;
+        uint16_t transaction_id;
+    };
+
+    command_batch(unsigned char destination_logical_address, unsigned char destination_key,
+        unsigned char source_logical_address, const route& r = {},
+        uint16_t first_transaction_id = 0)
+            : m_layout { r.layout() }, m_prototype(m_layout.header_size())
+    {
+        details::encode_command_fields(r, 0, destination_logical_address, destination_key,
+            source_logical_address, 0, 0, 0, 0, m_prototype.data());
+        reset(first_transaction_id);
+    }
+
+    void reset(uint16_t first_transaction_id = 0)
+    {
+        m_arena.clear();
+        m_entries.clear();
+        m_first_transaction_id = first_transaction_id;
+        m_sealed = 0;
+    }
+
+    void reserve(std::size_t commands, std::size_t bytes)
+    {
+        m_entries.reserve(commands);
+        m_headers.reserve(commands);
+        m_packets.reserve(commands);
+        m_arena.reserve(bytes);
+    }
+
+    /*
+     * Append commands, they return the transaction identifier of the command or std::nullopt
+     * when length does not fit in 24 bits.
+     */
+    template <unsigned char command_options = options::increment>
+    std::optional<uint16_t> add_read(
+        uint32_t address, uint32_t length, unsigned char extended_address = 0)
+    {
+        if (length >= (1 << 24))
+            return std::nullopt;
+        return append(read_packet_type<command_options>(), extended_address, address, length,
+            nullptr);
+    }
+
+    template <unsigned char command_options = options::acknowledge | options::increment>
+    std::optional<uint16_t> add_write(uint32_t address, const unsigned char* data,
+        uint32_t length, unsigned char extended_address = 0)
+    {
+        if (length >= (1 << 24))
+            return std::nullopt;
+        return append(write_packet_type<command_options>(), extended_address, address, length,
+            data);
+    }
+
+    /*
+     * Computes the header CRCs of the commands added since the last call.
+     */
+    void seal()
+    {
+        const std::size_t count = std::size(m_entries);
+        if (m_sealed == count)
+            return;
+        m_headers.resize(count - m_sealed);
+        for (std::size_t i = m_sealed; i < count; i++)
+            m_headers[i - m_sealed] = m_arena.data() + m_entries[i].offset + m_layout.path_size();
+        details::batch_crc::headers(m_headers.data(), std::size(m_headers),
+            m_layout.header_size() - m_layout.path_size() - 1);
+        m_sealed = count;
+    }
+
+    /*
+     * Seals the batch and sends every command in a single link call.
+     * Returns the number of commands sent.
+     */
+    std::size_t send(spacewire::link& link)
+    {
+        seal();
+        m_packets.resize(std::size(m_entries));
+        for (std::size_t i = 0; i < std::size(m_entries); i++)
+            m_packets[i] = const_buffer { m_arena.data() + m_entries[i].offset, m_entries[i].size };
+        return link.send_packets(m_packets.data(), std::size(m_packets));
+    }
+
+    std::size_t size() const { return std::size(m_entries); }
+    bool empty() const { return m_entries.empty(); }
+    std::size_t bytes() const { return std::size(m_arena); }
+    const unsigned char* data() const { return m_arena.data(); }
+    const entry& operator[](std::size_t index) const { return m_entries[index]; }
+    const unsigned char* packet(std::size_t index) const
+    {
+        return m_arena.data() + m_entries[index].offset;
+    }
+    uint16_t first_transaction_id() const { return m_first_transaction_id; }
+
+private:
+    uint16_t append(unsigned char packet_type, unsigned char extended_address, uint32_t address,
+        uint32_t length, const unsigned char* data)
+    {
+        const std::size_t header_size = m_layout.header_size();
+        const std::size_t size = data ? header_size + length + 1 : header_size;
+        const std::size_t offset = std::size(m_arena);
+        const auto transaction_id
+            = static_cast<uint16_t>(m_first_transaction_id + std::size(m_entries));
+        m_arena.resize(offset + size);
+        unsigned char* packet = m_arena.data() + offset;
+        std::memcpy(packet, m_prototype.data(), header_size);
+        const command_view<command_layout> view { packet, m_layout };
+        view.packet_type()
+            = packet_type | static_cast<unsigned char>(m_layout.reply_address_size() / 4);
+        view.transaction_id() = transaction_id;
+        view.extended_address() = extended_address;
+        view.address() = address;
+        view.data_length() = length;
+        if (data)
+        {
+            std::memcpy(view.data(), data, length);
+            view.data()[length] = spacewire::crc(data, length);
+        }
+        m_entries.push_back(entry { offset, size, transaction_id });
+        instrumentation::packet_built(size);
+        return transaction_id;
+    }
+
+    command_layout m_layout;
+    std::vector<unsigned char> m_prototype;
+    std::vector<unsigned char> m_arena;
+    std::vector<entry> m_entries;
+    std::vector<unsigned char*> m_headers;
+    std::vector<const_buffer> m_packets;
+    uint16_t m_first_transaction_id = 0;
+    std::size_t m_sealed = 0;
+};
+
+}
@@ -0,0 +1,288 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPACEWIREPP_HAS_CLMUL_CRC 1
+#include <immintrin.h>
+#endif
+
+/*
+ * RMAP CRC-8 (ECSS-E-ST-50-52C, 5.2):
+ *  polynomial x^8 + x^2 + x + 1, initial value 0, no final xor, bits are processed LSB first.
+ *
+ * Three engines produce the same result:
+ *  - static_crc: byte-wise table lookup, usable in constant expressions,
+ *  - slice-by-16: 16 bytes per iteration using tables of the CRC of one byte followed by n zeros,
+ *  - carry-less multiply: folds 64 bytes per iteration into 128 bits with PCLMULQDQ, then
+ *    finishes on the table engine. Selected at runtime when the CPU supports it.
+ */
+
+namespace spacewire
+{
+
+static constexpr std::array<unsigned char, 256> CRCTable { 0x00, 0x91, 0xe3, 0x72, 0x07, 0x96, 0xe4,
+    0x75, 0x0e, 0x9f, 0xed, 0x7c, 0x09, 0x98, 0xea, 0x7b, 0x1c, 0x8d, 0xff, 0x6e, 0x1b, 0x8a, 0xf8,
+    0x69, 0x12, 0x83, 0xf1, 0x60, 0x15, 0x84, 0xf6, 0x67, 0x38, 0xa9, 0xdb, 0x4a, 0x3f, 0xae, 0xdc,
+    0x4d, 0x36, 0xa7, 0xd5, 0x44, 0x31, 0xa0, 0xd2, 0x43, 0x24, 0xb5, 0xc7, 0x56, 0x23, 0xb2, 0xc0,
+    0x51, 0x2a, 0xbb, 0xc9, 0x58, 0x2d, 0xbc, 0xce, 0x5f, 0x70, 0xe1, 0x93, 0x02, 0x77, 0xe6, 0x94,
+    0x05, 0x7e, 0xef, 0x9d, 0x0c, 0x79, 0xe8, 0x9a, 0x0b, 0x6c, 0xfd, 0x8f, 0x1e, 0x6b, 0xfa, 0x88,
+    0x19, 0x62, 0xf3, 0x81, 0x10, 0x65, 0xf4, 0x86, 0x17, 0x48, 0xd9, 0xab, 0x3a, 0x4f, 0xde, 0xac,
+    0x3d, 0x46, 0xd7, 0xa5, 0x34, 0x41, 0xd0, 0xa2, 0x33, 0x54, 0xc5, 0xb7, 0x26, 0x53, 0xc2, 0xb0,
+    0x21, 0x5a, 0xcb, 0xb9, 0x28, 0x5d, 0xcc, 0xbe, 0x2f, 0xe0, 0x71, 0x03, 0x92, 0xe7, 0x76, 0x04,
+    0x95, 0xee, 0x7f, 0x0d, 0x9c, 0xe9, 0x78, 0x0a, 0x9b, 0xfc, 0x6d, 0x1f, 0x8e, 0xfb, 0x6a, 0x18,
+    0x89, 0xf2, 0x63, 0x11, 0x80, 0xf5, 0x64, 0x16, 0x87, 0xd8, 0x49, 0x3b, 0xaa, 0xdf, 0x4e, 0x3c,
+    0xad, 0xd6, 0x47, 0x35, 0xa4, 0xd1, 0x40, 0x32, 0xa3, 0xc4, 0x55, 0x27, 0xb6, 0xc3, 0x52, 0x20,
+    0xb1, 0xca, 0x5b, 0x29, 0xb8, 0xcd, 0x5c, 0x2e, 0xbf, 0x90, 0x01, 0x73, 0xe2, 0x97, 0x06, 0x74,
+    0xe5, 0x9e, 0x0f, 0x7d, 0xec, 0x99, 0x08, 0x7a, 0xeb, 0x8c, 0x1d, 0x6f, 0xfe, 0x8b, 0x1a, 0x68,
+    0xf9, 0x82, 0x13, 0x61, 0xf0, 0x85, 0x14, 0x66, 0xf7, 0xa8, 0x39, 0x4b, 0xda, 0xaf, 0x3e, 0x4c,
+    0xdd, 0xa6, 0x37, 0x45, 0xd4, 0xa1, 0x30, 0x42, 0xd3, 0xb4, 0x25, 0x57, 0xc6, 0xb3, 0x22, 0x50,
+    0xc1, 0xba, 0x2b, 0x59, 0xc8, 0xbd, 0x2c, 0x5e, 0xcf };
+
+inline constexpr unsigned char static_crc(
+    const unsigned char* buffer, std::size_t size, unsigned char init = 0)
+{
+    unsigned char crc = init;
+    for (std::size_t i = 0; i < size; i++)
+        crc = CRCTable[crc ^ buffer[i]];
+    return crc;
+}
+
+template <std::size_t size>
+inline constexpr unsigned char static_crc(
+    const std::array<unsigned char, size>& buffer, unsigned char init = 0)
+{
+    unsigned char crc = init;
+    for (std::size_t i = 0; i < size; i++)
+        crc = CRCTable[crc ^ buffer[i]];
+    return crc;
+}
+
+namespace details::crc
+{
+    static constexpr std::size_t slices = 16;
+
+    // SliceTables[n][x] is the CRC of byte x followed by n zero bytes.
+    // Since the CRC is linear, the CRC of a block is the xor of the contribution of each byte.
+    static constexpr auto make_slice_tables()
+    {
+        std::array<std::array<unsigned char, 256>, slices> tables {};
+        for (std::size_t x = 0; x < 256; x++)
+        {
+            tables[0][x] = CRCTable[x];
+            for (std::size_t n = 1; n < slices; n++)
+                tables[n][x] = CRCTable[tables[n - 1][x]];
+        }
+        return tables;
+    }
+
+    alignas(64) static constexpr auto SliceTables = make_slice_tables();
+
+    inline unsigned char slice_by_16(
+        const unsigned char* buffer, std::size_t size, unsigned char crc)
+    {
+        const auto& t = SliceTables;
+        while (size >= 16)
+        {
+            crc = t[15][crc ^ buffer[0]] ^ t[14][buffer[1]] ^ t[13][buffer[2]] ^ t[12][buffer[3]]
+                ^ t[11][buffer[4]] ^ t[10][buffer[5]] ^ t[9][buffer[6]] ^ t[8][buffer[7]]
+                ^ t[7][buffer[8]] ^ t[6][buffer[9]] ^ t[5][buffer[10]] ^ t[4][buffer[11]]
+                ^ t[3][buffer[12]] ^ t[2][buffer[13]] ^ t[1][buffer[14]] ^ t[0][buffer[15]];
+            buffer += 16;
+            size -= 16;
+        }
+        if (size >= 8)
+        {
+            crc = t[7][crc ^ buffer[0]] ^ t[6][buffer[1]] ^ t[5][buffer[2]] ^ t[4][buffer[3]]
+                ^ t[3][buffer[4]] ^ t[2][buffer[5]] ^ t[1][buffer[6]] ^ t[0][buffer[7]];
+            buffer += 8;
+            size -= 8;
+        }
+        return static_crc(buffer, size, crc);
+    }
+
+#ifdef SPACEWIREPP_HAS_CLMUL_CRC
+    // x^n mod P(x), P(x) = x^8 + x^2 + x + 1
+    static constexpr unsigned char x_pow_mod(std::size_t n)
+    {
+        unsigned int r = 1;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            r <<= 1;
+            if (r & 0x100)
+                r ^= 0x107;
+        }
+        return static_cast<unsigned char>(r);
+    }
+
+    // Bit-reflected 64 bits operand: bit j holds the coefficient of x^(63-j).
+    // The product of two reflected operands lands one bit too low, which is compensated by
+    // folding with x^(n-1) instead of x^n.
+    static constexpr uint64_t fold_constant(std::size_t n)
+    {
+        const unsigned char r = x_pow_mod(n - 1);
+        uint64_t k = 0;
+        for (int d = 0; d < 8; d++)
+            if (r & (1 << d))
+                k |= uint64_t { 1 } << (63 - d);
+        return k;
+    }
+
+    // Folding constants to move a 128 bits block forward by n blocks:
+    // low qword is multiplied by x^(128n+64), high qword by x^(128n)
+    template <std::size_t blocks>
+    inline constexpr std::array<uint64_t, 2> fold_constants {
+        fold_constant(128 * blocks + 64), fold_constant(128 * blocks)
+    };
+
+    __attribute__((target("sse2,pclmul"))) inline __m128i fold(
+        __m128i acc, __m128i k, __m128i next)
+    {
+        return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x00),
+                                 _mm_clmulepi64_si128(acc, k, 0x11)),
+            next);
+    }
+
+    __attribute__((target("sse2,pclmul"))) inline __m128i load_constants(
+        const std::array<uint64_t, 2>& k)
+    {
+        return _mm_set_epi64x(static_cast<long long>(k[1]), static_cast<long long>(k[0]));
+    }
+
+    __attribute__((target("sse2,pclmul"))) inline unsigned char clmul(
+        const unsigned char* buffer, std::size_t size, unsigned char crc)
+    {
+        if (size < 64)
+            return slice_by_16(buffer, size, crc);
+        auto load = [](const unsigned char* p)
+        { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+        // A non zero initial value is equivalent to xoring it with the first message byte
+        __m128i acc0 = _mm_xor_si128(load(buffer), _mm_cvtsi32_si128(crc));
+        __m128i acc1 = load(buffer + 16);
+        __m128i acc2 = load(buffer + 32);
+        __m128i acc3 = load(buffer + 48);
+        buffer += 64;
+        size -= 64;
+        const __m128i k4 = load_constants(fold_constants<4>);
+        while (size >= 64)
+        {
+            acc0 = fold(acc0, k4, load(buffer));
+            acc1 = fold(acc1, k4, load(buffer + 16));
+            acc2 = fold(acc2, k4, load(buffer + 32));
+            acc3 = fold(acc3, k4, load(buffer + 48));
+            buffer += 64;
+            size -= 64;
+        }
+        const __m128i k1 = load_constants(fold_constants<1>);
+        __m128i acc = fold(acc0, k1, acc1);
+        acc = fold(acc, k1, acc2);
+        acc = fold(acc, k1, acc3);
+        while (size >= 16)
+        {
+            acc = fold(acc, k1, load(buffer));
+            buffer += 16;
+            size -= 16;
+        }
+        // acc is congruent to the whole folded prefix, its CRC is the CRC of the prefix
+        alignas(16) unsigned char tail[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(tail), acc);
+        return slice_by_16(buffer, size, slice_by_16(tail, 16, 0));
+    }
+
+    inline bool has_clmul()
+    {
+        static const bool supported = __builtin_cpu_supports("pclmul");
+        return supported;
+    }
+#endif
+
+    inline unsigned char dispatch(const unsigned char* buffer, std::size_t size, unsigned char crc)
+    {
+#ifdef SPACEWIREPP_HAS_CLMUL_CRC
+        if (size >= 256 && has_clmul())
+            return clmul(buffer, size, crc);
+#endif
+        return slice_by_16(buffer, size, crc);
+    }
+}
+
+inline unsigned char crc(const unsigned char* buffer, std::size_t size, unsigned char init = 0)
+{
+    return details::crc::dispatch(buffer, size, init);
+}
+
+/*
+ * Copies size bytes from source to destination and returns their CRC.
+ * Each block is copied then checksummed while it is still in L1, so source is read from
+ * memory once instead of twice for a memcpy() followed by crc(). The buffers must not overlap.
+ */
+inline unsigned char crc_copy(unsigned char* destination, const unsigned char* source,
+    std::size_t size, unsigned char init = 0)
+{
+    constexpr std::size_t block = 4096;
+    unsigned char value = init;
+    for (std::size_t offset = 0; offset < size; offset += block)
+    {
+        const std::size_t n = std::min(block, size - offset);
+        std::memcpy(destination + offset, source + offset, n);
+        value = details::crc::dispatch(destination + offset, n, value);
+    }
+    return value;
+}
+
+/*
+ * Incremental CRC, feeding a buffer in several chunks gives the same result as a single
+ * crc() call over the whole buffer.
+ */
+struct crc_state
+{
+    unsigned char value = 0;
+
+    constexpr crc_state() = default;
+    constexpr explicit crc_state(unsigned char init) : value { init } { }
+
+    crc_state& update(const unsigned char* buffer, std::size_t size)
+    {
+        value = crc(buffer, size, value);
+        return *this;
+    }
+
+    constexpr crc_state& update(unsigned char byte)
+    {
+        value = CRCTable[value ^ byte];
+        return *this;
+    }
+
+    constexpr crc_state static_update(const unsigned char* buffer, std::size_t size) const
+    {
+        return crc_state { static_crc(buffer, size, value) };
+    }
+
+    constexpr operator unsigned char() const { return value; }
+};
+
+}
@@ -0,0 +1,243 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "SpaceWire.hpp"
+#include "ccsds.hpp"
+#include "packet_view.hpp"
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace spacewire
+{
+
+/*
+ * Undecoded packet, handed to handlers of protocols without a dedicated view (GOES-R, STUP,
+ * extended protocol identifiers) and to the fallback handler.
+ */
+class raw_packet_view
+{
+public:
+    raw_packet_view(const unsigned char* packet, std::size_t size) noexcept
+            : m_packet { packet }, m_size { size }
+    {
+    }
+
+    const unsigned char* packet() const noexcept { return m_packet; }
+    std::size_t size() const noexcept { return m_size; }
+    // only meaningful when size() >= 2
+    unsigned char protocol_identifier() const noexcept { return m_packet[1]; }
+
+private:
+    const unsigned char* m_packet;
+    std::size_t m_size;
+};
+
+template <protocol_id_t protocol>
+struct protocol_traits
+{
+    using view_type = raw_packet_view;
+};
+
+template <>
+struct protocol_traits<protocol_id_t::SPW_PROTO_ID_RMAP>
+{
+    using view_type = rmap::packet_view;
+};
+
+template <>
+struct protocol_traits<protocol_id_t::SPW_PROTO_ID_CCSDS>
+{
+    using view_type = ccsds::packet_view;
+};
+
+template <protocol_id_t id, typename callback_t>
+struct protocol_handler
+{
+    static constexpr protocol_id_t protocol = id;
+    callback_t callback;
+};
+
+template <typename callback_t>
+struct fallback_handler
+{
+    callback_t callback;
+};
+
+/*
+ * Handler of protocol id, callback is called with the protocol_traits<id>::view_type view.
+ */
+template <protocol_id_t id, typename callback_t>
+protocol_handler<id, std::decay_t<callback_t>> on(callback_t&& callback)
+{
+    return { std::forward<callback_t>(callback) };
+}
+
+/*
+ * Handler of packets without a dedicated handler and of packets too short to carry a protocol
+ * identifier, callback is called with a raw_packet_view.
+ */
+template <typename callback_t>
+fallback_handler<std::decay_t<callback_t>> otherwise(callback_t&& callback)
+{
+    return { std::forward<callback_t>(callback) };
+}
+
+namespace details::dispatch
+{
+    template <typename T>
+    struct is_fallback : std::false_type
+    {
+    };
+    template <typename callback_t>
+    struct is_fallback<fallback_handler<callback_t>> : std::true_type
+    {
+    };
+
+    template <typename dispatcher_t>
+    using thunk_t = void (*)(
+        dispatcher_t&, const unsigned char*, std::size_t, const rmap::packet_view*);
+
+    template <typename dispatcher_t>
+    void unhandled(dispatcher_t& dispatcher, const unsigned char* packet, std::size_t size,
+        const rmap::packet_view*)
+    {
+        dispatcher.fallback(raw_packet_view { packet, size });
+    }
+
+    template <typename dispatcher_t, std::size_t index>
+    void call(dispatcher_t& dispatcher, const unsigned char* packet, std::size_t size,
+        const rmap::packet_view* decoded)
+    {
+        auto& handler = std::get<index>(dispatcher.handlers());
+        constexpr protocol_id_t protocol = std::decay_t<decltype(handler)>::protocol;
+        if constexpr (protocol == protocol_id_t::SPW_PROTO_ID_RMAP)
+        {
+            if (decoded)
+                return handler.callback(*decoded);
+        }
+        handler.callback(typename protocol_traits<protocol>::view_type { packet, size });
+    }
+
+    template <typename dispatcher_t, typename handlers_t, std::size_t... indexes>
+    constexpr std::array<thunk_t<dispatcher_t>, 256> make_table(std::index_sequence<indexes...>)
+    {
+        std::array<thunk_t<dispatcher_t>, 256> table {};
+        for (auto& entry : table)
+            entry = &unhandled<dispatcher_t>;
+        (
+            [&table]()
+            {
+                using handler_t = std::tuple_element_t<indexes, handlers_t>;
+                if constexpr (!is_fallback<handler_t>::value)
+                    table[static_cast<unsigned char>(handler_t::protocol)]
+                        = &call<dispatcher_t, indexes>;
+            }(),
+            ...);
+        return table;
+    }
+
+    template <typename dispatcher_t, typename handlers_t>
+    inline constexpr std::array<thunk_t<dispatcher_t>, 256> table
+        = make_table<dispatcher_t, handlers_t>(
+            std::make_index_sequence<std::tuple_size_v<handlers_t>>());
+}
+
+/*
+ * Routes packets to typed handlers by protocol identifier.
+ *
+ * The routing table is a constexpr array of 256 function pointers indexed by the protocol
+ * identifier byte, so each packet costs one indirect call whatever the number of handlers.
+ * Each handler only decodes what its protocol needs, a protocol without a handler is passed
+ * to the fallback handler when there is one and dropped otherwise.
+ *
+ *   auto dispatcher = make_dispatcher(
+ *       on<protocol_id_t::SPW_PROTO_ID_RMAP>([](const rmap::packet_view& p) { ... }),
+ *       on<protocol_id_t::SPW_PROTO_ID_CCSDS>([](const ccsds::packet_view& p) { ... }),
+ *       otherwise([](const raw_packet_view& p) { ... }));
+ *
+ * Packets must use logical addressing, path address bytes have to be stripped before.
+ */
+template <typename... handler_t>
+class protocol_dispatcher
+{
+    static_assert((std::size_t { details::dispatch::is_fallback<handler_t>::value } + ... + 0) <= 1,
+        "at most one fallback handler");
+
+public:
+    explicit protocol_dispatcher(handler_t... handlers) : m_handlers { std::move(handlers)... } { }
+
+    void operator()(const unsigned char* packet, std::size_t size)
+    {
+        dispatch(packet, size, nullptr);
+    }
+
+    /*
+     * Dispatches an already decoded packet, RMAP handlers get view itself so its CRCs are not
+     * checked twice. Handy for packets coming from a receive_pipeline.
+     */
+    void operator()(const rmap::packet_view& view)
+    {
+        dispatch(view.packet(), view.size(), &view);
+    }
+
+    std::tuple<handler_t...>& handlers() { return m_handlers; }
+
+    void fallback(const raw_packet_view& packet)
+    {
+        std::apply(
+            [&packet](auto&... handlers)
+            {
+                (
+                    [&packet](auto& handler)
+                    {
+                        if constexpr (details::dispatch::is_fallback<
+                                          std::decay_t<decltype(handler)>>::value)
+                            handler.callback(packet);
+                    }(handlers),
+                    ...);
+            },
+            m_handlers);
+    }
+
+private:
+    void dispatch(const unsigned char* packet, std::size_t size, const rmap::packet_view* decoded)
+    {
+        if (size < 2)
+            return fallback(raw_packet_view { packet, size });
+        details::dispatch::table<protocol_dispatcher, std::tuple<handler_t...>>[packet[1]](
+            *this, packet, size, decoded);
+    }
+
+    std::tuple<handler_t...> m_handlers;
+};
+
+template <typename... handler_t>
+protocol_dispatcher<std::decay_t<handler_t>...> make_dispatcher(handler_t&&... handlers)
+{
+    return protocol_dispatcher<std::decay_t<handler_t>...> { std::forward<handler_t>(
+        handlers)... };
+}
+
+}
@@ -0,0 +1,193 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "ring.hpp"
+#include "timestamp.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace spacewire
+{
+
+/*
+ * SpaceWire time-code (ECSS-E-ST-50-12C, 8.12): a 6 bits time counter and 2 control flags.
+ */
+struct time_code
+{
+    unsigned char value = 0;
+
+    constexpr time_code() = default;
+    constexpr explicit time_code(unsigned char value) : value { value } { }
+    static constexpr time_code make(unsigned char time, unsigned char flags = 0)
+    {
+        return time_code { static_cast<unsigned char>((flags << 6) | (time & 0x3F)) };
+    }
+
+    constexpr unsigned char time() const { return value & 0x3F; }
+    constexpr unsigned char flags() const { return value >> 6; }
+    constexpr time_code next() const { return make(time() + 1, flags()); }
+    // time-code periods from this time-code to other, modulo 64
+    constexpr unsigned char distance_to(time_code other) const
+    {
+        return (other.time() - time()) & 0x3F;
+    }
+
+    constexpr bool operator==(const time_code& other) const { return value == other.value; }
+    constexpr bool operator!=(const time_code& other) const { return value != other.value; }
+};
+
+// ECSS-E-ST-50-12C, 8.5.2 link interface state machine
+enum class link_state : unsigned char
+{
+    error_reset,
+    error_wait,
+    ready,
+    started,
+    connecting,
+    run
+};
+
+enum class link_error : unsigned char
+{
+    disconnect,
+    parity,
+    escape,
+    credit,
+    character_sequence,
+    eep_received
+};
+
+enum class event_kind : unsigned char
+{
+    packet_sent,
+    packet_received,
+    time_code_sent,
+    time_code_received,
+    state_changed,
+    error
+};
+
+/*
+ * Event observed on a link, timestamped with timestamp_clock where it crossed the link.
+ * Packet events carry the packet size and its first bytes, enough to match RMAP transactions.
+ */
+struct link_event
+{
+    static constexpr std::size_t head_size = 8;
+
+    timestamp_t timestamp = 0;
+    event_kind kind = event_kind::packet_sent;
+    time_code code;
+    link_state state = link_state::error_reset;
+    link_error error = link_error::disconnect;
+    uint32_t size = 0;
+    std::array<unsigned char, head_size> head {};
+
+    static link_event packet(event_kind kind, timestamp_t timestamp, const unsigned char* packet,
+        std::size_t size)
+    {
+        link_event e;
+        e.timestamp = timestamp;
+        e.kind = kind;
+        e.size = static_cast<uint32_t>(size);
+        std::copy(packet, packet + std::min(size, head_size), std::begin(e.head));
+        return e;
+    }
+
+    static link_event time_code_event(event_kind kind, timestamp_t timestamp, time_code code)
+    {
+        link_event e;
+        e.timestamp = timestamp;
+        e.kind = kind;
+        e.code = code;
+        return e;
+    }
+
+    static link_event state_event(timestamp_t timestamp, link_state state)
+    {
+        link_event e;
+        e.timestamp = timestamp;
+        e.kind = event_kind::state_changed;
+        e.state = state;
+        return e;
+    }
+
+    static link_event error_event(timestamp_t timestamp, link_error error)
+    {
+        link_event e;
+        e.timestamp = timestamp;
+        e.kind = event_kind::error;
+        e.error = error;
+        return e;
+    }
+};
+
+/*
+ * Bounded queue of link events from any number of producers to their observers.
+ * publish() never blocks nor allocates: when observers fall behind, events are dropped and
+ * counted instead of slowing the packet path down.
+ */
+class event_channel
+{
+public:
+    explicit event_channel(std::size_t capacity = 4096) : m_ring { capacity } { }
+
+    bool publish(link_event event)
+    {
+        if (m_ring.try_push(event))
+            return true;
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::optional<link_event> poll() { return m_ring.try_pop(); }
+
+    /*
+     * Calls callback(event) for up to max pending events, returns how many were handled.
+     */
+    template <typename callback_t>
+    std::size_t drain(callback_t&& callback, std::size_t max = SIZE_MAX)
+    {
+        std::size_t count = 0;
+        for (; count < max; count++)
+        {
+            auto event = m_ring.try_pop();
+            if (!event)
+                break;
+            callback(*event);
+        }
+        return count;
+    }
+
+    std::size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    std::size_t capacity() const { return m_ring.capacity(); }
+
+private:
+    bounded_ring<link_event> m_ring;
+    std::atomic<std::size_t> m_dropped { 0 };
+};
+
+}
@@ -0,0 +1,91 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace spacewire
+{
+
+/*
+ * Lock-free LIFO of indexes in [0, capacity), safe for any number of concurrent producers and
+ * consumers. The head carries a generation counter in its upper 32 bits to defeat ABA.
+ */
+class index_freelist
+{
+public:
+    static constexpr uint32_t npos = 0xFFFFFFFF;
+
+    explicit index_freelist(std::size_t capacity)
+            : m_capacity { capacity }, m_next { new std::atomic<uint32_t>[capacity] }
+    {
+        for (std::size_t i = 0; i < capacity; i++)
+            m_next[i].store(i + 1 < capacity ? static_cast<uint32_t>(i + 1) : npos,
+                std::memory_order_relaxed);
+        m_head.store(pack(capacity ? 0 : npos, 0), std::memory_order_release);
+    }
+
+    index_freelist(const index_freelist&) = delete;
+    index_freelist& operator=(const index_freelist&) = delete;
+
+    std::optional<uint32_t> pop()
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        while (index(head) != npos)
+        {
+            const uint32_t next = m_next[index(head)].load(std::memory_order_relaxed);
+            if (m_head.compare_exchange_weak(head, pack(next, tag(head) + 1),
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+                return index(head);
+        }
+        return std::nullopt;
+    }
+
+    void push(uint32_t value)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        do
+        {
+            m_next[value].store(index(head), std::memory_order_relaxed);
+        } while (!m_head.compare_exchange_weak(head, pack(value, tag(head) + 1),
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    bool empty() const { return index(m_head.load(std::memory_order_acquire)) == npos; }
+    std::size_t capacity() const { return m_capacity; }
+
+private:
+    static constexpr uint64_t pack(uint32_t index, uint32_t tag)
+    {
+        return (uint64_t { tag } << 32) | index;
+    }
+    static constexpr uint32_t index(uint64_t head) { return static_cast<uint32_t>(head); }
+    static constexpr uint32_t tag(uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+
+    std::size_t m_capacity;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+    alignas(64) std::atomic<uint64_t> m_head;
+};
+
+}
@@ -0,0 +1,400 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "timestamp.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*
+ * Opt-in hot path instrumentation, enabled by defining SPACEWIREPP_INSTRUMENTATION to 1 (meson
+ * option with_instrumentation). When disabled every recording function is an empty inline
+ * function and round_trip_tracker holds no storage, so instrumented code compiles to nothing.
+ *
+ * Each thread records into its own shard of relaxed atomics that only it writes, recording is
+ * a plain load and store without any lock prefixed instruction. Shards are linked in a lock-free
+ * list never shrinking: a shard left by an exiting thread keeps its counts and is reused by the
+ * next new thread. snapshot() sums every shard while threads keep recording.
+ */
+#ifndef SPACEWIREPP_INSTRUMENTATION
+#define SPACEWIREPP_INSTRUMENTATION 0
+#endif
+
+namespace spacewire::instrumentation
+{
+
+inline constexpr bool enabled = SPACEWIREPP_INSTRUMENTATION != 0;
+
+enum class counter : unsigned char
+{
+    packets_built,
+    bytes_built,
+    packets_parsed,
+    bytes_parsed,
+    header_crc_errors,
+    data_crc_errors,
+    round_trips,
+    count
+};
+
+inline constexpr std::size_t counter_count = static_cast<std::size_t>(counter::count);
+
+inline constexpr const char* counter_names[counter_count] = { "packets_built", "bytes_built",
+    "packets_parsed", "bytes_parsed", "header_crc_errors", "data_crc_errors", "round_trips" };
+
+struct snapshot;
+snapshot take_snapshot();
+
+/*
+ * Log-linear histogram of nanosecond latencies in the spirit of HdrHistogram: values below
+ * 2^sub_bucket_bits are exact, above each power of two is split in 2^sub_bucket_bits buckets,
+ * so the relative error stays under 2^-sub_bucket_bits (about 3%). Values are clamped to
+ * 2^max_value_bits - 1 ns, about 18 minutes.
+ */
+class latency_histogram
+{
+public:
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr unsigned max_value_bits = 40;
+    static constexpr std::size_t sub_bucket_count = std::size_t { 1 } << sub_bucket_bits;
+    static constexpr std::size_t bucket_count
+        = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+    static constexpr std::size_t bucket_index(uint64_t value)
+    {
+        value = std::min(value, (uint64_t { 1 } << max_value_bits) - 1);
+        if (value < sub_bucket_count)
+            return static_cast<std::size_t>(value);
+        unsigned exponent = 63;
+        while (!(value >> exponent))
+            exponent--;
+        const unsigned shift = exponent - sub_bucket_bits;
+        return (shift + 1) * sub_bucket_count
+            + static_cast<std::size_t>((value >> shift) & (sub_bucket_count - 1));
+    }
+
+    static constexpr uint64_t bucket_lowest_value(std::size_t index)
+    {
+        if (index < sub_bucket_count)
+            return index;
+        const std::size_t shift = index / sub_bucket_count - 1;
+        return (sub_bucket_count + index % sub_bucket_count) << shift;
+    }
+
+    static constexpr uint64_t bucket_highest_value(std::size_t index)
+    {
+        if (index < sub_bucket_count)
+            return index;
+        return bucket_lowest_value(index) + (uint64_t { 1 } << (index / sub_bucket_count - 1)) - 1;
+    }
+
+    void record(uint64_t value, uint64_t count = 1)
+    {
+        m_buckets[bucket_index(value)] += count;
+        m_count += count;
+        m_sum += value * count;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    void merge(const latency_histogram& other)
+    {
+        for (std::size_t i = 0; i < bucket_count; i++)
+            m_buckets[i] += other.m_buckets[i];
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    uint64_t count() const { return m_count; }
+    uint64_t min() const { return m_count ? m_min : 0; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0.; }
+    uint64_t bucket(std::size_t index) const { return m_buckets[index]; }
+
+    /*
+     * Highest value of the bucket holding the percentile (in [0, 100]), bounded by max().
+     */
+    uint64_t value_at_percentile(double percentile) const
+    {
+        if (m_count == 0)
+            return 0;
+        const double clamped = std::clamp(percentile, 0., 100.);
+        const auto rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(clamped / 100. * static_cast<double>(m_count) + 0.5));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; i++)
+        {
+            seen += m_buckets[i];
+            if (seen >= rank)
+                return std::min(bucket_highest_value(i), m_max);
+        }
+        return m_max;
+    }
+
+private:
+    friend snapshot take_snapshot();
+
+    std::array<uint64_t, bucket_count> m_buckets {};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = UINT64_MAX;
+    uint64_t m_max = 0;
+};
+
+struct snapshot
+{
+    std::array<uint64_t, counter_count> counters {};
+    // indexed by status byte of parsed replies
+    std::array<uint64_t, 256> statuses {};
+    latency_histogram round_trip;
+
+    uint64_t operator[](counter c) const { return counters[static_cast<std::size_t>(c)]; }
+};
+
+namespace details
+{
+    struct shard
+    {
+        std::array<std::atomic<uint64_t>, counter_count> counters {};
+        std::array<std::atomic<uint64_t>, 256> statuses {};
+        std::array<std::atomic<uint64_t>, latency_histogram::bucket_count> latency {};
+        std::atomic<uint64_t> latency_sum { 0 };
+        std::atomic<uint64_t> latency_min { UINT64_MAX };
+        std::atomic<uint64_t> latency_max { 0 };
+        std::atomic<bool> in_use { true };
+        shard* next = nullptr;
+    };
+
+    // only the owning thread writes a shard, no read-modify-write needed
+    inline void bump(std::atomic<uint64_t>& value, uint64_t n)
+    {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline std::atomic<shard*>& shards()
+    {
+        static std::atomic<shard*> head { nullptr };
+        return head;
+    }
+
+    inline shard* acquire_shard()
+    {
+        auto& head = shards();
+        for (shard* s = head.load(std::memory_order_acquire); s; s = s->next)
+        {
+            bool free = false;
+            if (!s->in_use.load(std::memory_order_relaxed)
+                && s->in_use.compare_exchange_strong(free, true, std::memory_order_acquire))
+                return s;
+        }
+        shard* s = new shard;
+        s->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(
+            s->next, s, std::memory_order_release, std::memory_order_relaxed))
+            ;
+        return s;
+    }
+
+    struct shard_owner
+    {
+        shard* s = acquire_shard();
+        ~shard_owner() { s->in_use.store(false, std::memory_order_release); }
+    };
+
+    inline shard& local_shard()
+    {
+        thread_local shard_owner owner;
+        return *owner.s;
+    }
+}
+
+inline void add(counter c, uint64_t n = 1)
+{
+    if constexpr (enabled)
+        details::bump(details::local_shard().counters[static_cast<std::size_t>(c)], n);
+}
+
+inline void packet_built(std::size_t size)
+{
+    if constexpr (enabled)
+    {
+        auto& s = details::local_shard();
+        details::bump(s.counters[static_cast<std::size_t>(counter::packets_built)], 1);
+        details::bump(s.counters[static_cast<std::size_t>(counter::bytes_built)], size);
+    }
+}
+
+inline void packet_parsed(std::size_t size, bool header_crc_error, bool data_crc_error)
+{
+    if constexpr (enabled)
+    {
+        auto& s = details::local_shard();
+        details::bump(s.counters[static_cast<std::size_t>(counter::packets_parsed)], 1);
+        details::bump(s.counters[static_cast<std::size_t>(counter::bytes_parsed)], size);
+        details::bump(
+            s.counters[static_cast<std::size_t>(counter::header_crc_errors)], header_crc_error);
+        details::bump(
+            s.counters[static_cast<std::size_t>(counter::data_crc_errors)], data_crc_error);
+    }
+}
+
+inline void status(unsigned char status)
+{
+    if constexpr (enabled)
+        details::bump(details::local_shard().statuses[status], 1);
+}
+
+inline void round_trip(std::chrono::nanoseconds latency)
+{
+    if constexpr (enabled)
+    {
+        auto& s = details::local_shard();
+        const auto value = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+        details::bump(s.counters[static_cast<std::size_t>(counter::round_trips)], 1);
+        details::bump(s.latency[latency_histogram::bucket_index(value)], 1);
+        details::bump(s.latency_sum, value);
+        if (value < s.latency_min.load(std::memory_order_relaxed))
+            s.latency_min.store(value, std::memory_order_relaxed);
+        if (value > s.latency_max.load(std::memory_order_relaxed))
+            s.latency_max.store(value, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Sums every shard, counts recorded concurrently may or may not be included.
+ * Always empty when instrumentation is disabled.
+ */
+inline snapshot take_snapshot()
+{
+    snapshot result;
+    if constexpr (enabled)
+    {
+        for (auto* s = details::shards().load(std::memory_order_acquire); s; s = s->next)
+        {
+            for (std::size_t i = 0; i < counter_count; i++)
+                result.counters[i] += s->counters[i].load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < std::size(result.statuses); i++)
+                result.statuses[i] += s->statuses[i].load(std::memory_order_relaxed);
+            latency_histogram latency;
+            for (std::size_t i = 0; i < latency_histogram::bucket_count; i++)
+                latency.m_count += latency.m_buckets[i]
+                    = s->latency[i].load(std::memory_order_relaxed);
+            latency.m_sum = s->latency_sum.load(std::memory_order_relaxed);
+            latency.m_min = s->latency_min.load(std::memory_order_relaxed);
+            latency.m_max = s->latency_max.load(std::memory_order_relaxed);
+            result.round_trip.merge(latency);
+        }
+    }
+    return result;
+}
+
+/*
+ * Request to reply latency keyed on transaction identifier, for identifiers in [0, capacity).
+ * sent() and received() can be called from different threads. Both ends are timestamp_clock
+ * ticks, converted to nanoseconds only once the reply is in.
+ */
+class round_trip_tracker
+{
+public:
+    explicit round_trip_tracker(std::size_t capacity)
+    {
+        if constexpr (enabled)
+        {
+            m_sent.reset(new std::atomic<timestamp_t>[capacity]);
+            for (std::size_t i = 0; i < capacity; i++)
+                m_sent[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void sent(uint16_t transaction_id)
+    {
+        if constexpr (enabled)
+            m_sent[transaction_id].store(timestamp_clock::now(), std::memory_order_relaxed);
+    }
+
+    void received(uint16_t transaction_id)
+    {
+        if constexpr (enabled)
+        {
+            if (const timestamp_t sent
+                = m_sent[transaction_id].exchange(0, std::memory_order_relaxed);
+                sent)
+                round_trip(timestamp_clock::elapsed(sent, timestamp_clock::now()));
+        }
+    }
+
+private:
+    std::unique_ptr<std::atomic<timestamp_t>[]> m_sent;
+};
+
+inline std::string to_text(const snapshot& s)
+{
+    std::string text;
+    for (std::size_t i = 0; i < counter_count; i++)
+        text += std::string { counter_names[i] } + " " + std::to_string(s.counters[i]) + "\n";
+    for (std::size_t i = 0; i < std::size(s.statuses); i++)
+        if (s.statuses[i])
+            text += "status[" + std::to_string(i) + "] " + std::to_string(s.statuses[i]) + "\n";
+    const auto& h = s.round_trip;
+    text += "round_trip_ns count=" + std::to_string(h.count()) + " min=" + std::to_string(h.min())
+        + " p50=" + std::to_string(h.value_at_percentile(50))
+        + " p90=" + std::to_string(h.value_at_percentile(90))
+        + " p99=" + std::to_string(h.value_at_percentile(99))
+        + " p99.9=" + std::to_string(h.value_at_percentile(99.9))
+        + " max=" + std::to_string(h.max()) + " mean=" + std::to_string(h.mean()) + "\n";
+    return text;
+}
+
+inline std::string to_json(const snapshot& s)
+{
+    std::string json = "{\"counters\":{";
+    for (std::size_t i = 0; i < counter_count; i++)
+        json += (i ? ",\"" : "\"") + std::string { counter_names[i] }
+            + "\":" + std::to_string(s.counters[i]);
+    json += "},\"statuses\":{";
+    bool first = true;
+    for (std::size_t i = 0; i < std::size(s.statuses); i++)
+    {
+        if (!s.statuses[i])
+            continue;
+        json += (first ? "\"" : ",\"") + std::to_string(i) + "\":" + std::to_string(s.statuses[i]);
+        first = false;
+    }
+    const auto& h = s.round_trip;
+    json += "},\"round_trip_ns\":{\"count\":" + std::to_string(h.count())
+        + ",\"min\":" + std::to_string(h.min())
+        + ",\"p50\":" + std::to_string(h.value_at_percentile(50))
+        + ",\"p90\":" + std::to_string(h.value_at_percentile(90))
+        + ",\"p99\":" + std::to_string(h.value_at_percentile(99))
+        + ",\"p999\":" + std::to_string(h.value_at_percentile(99.9))
+        + ",\"max\":" + std::to_string(h.max()) + ",\"mean\":" + std::to_string(h.mean()) + "}}";
+    return json;
+}
+
+}
@@ -0,0 +1,518 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "events.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace spacewire
+{
+
+struct const_buffer
+{
+    const unsigned char* data;
+    std::size_t size;
+};
+
+struct mutable_buffer
+{
+    unsigned char* data;
+    std::size_t size;
+};
+
+class link;
+
+/*
+ * Received packet lent by a link, data() stays valid until the lease is released or destroyed.
+ * Leases must be released before their link is moved or destroyed.
+ */
+class receive_lease
+{
+public:
+    receive_lease() = default;
+    receive_lease(
+        const unsigned char* data, std::size_t size, link* owner, std::uintptr_t token = 0)
+            : m_data { data }, m_size { size }, m_owner { owner }, m_token { token }
+    {
+    }
+    ~receive_lease() { release(); }
+
+    receive_lease(const receive_lease&) = delete;
+    receive_lease& operator=(const receive_lease&) = delete;
+    receive_lease(receive_lease&& other) noexcept
+            : m_data { other.m_data }
+            , m_size { other.m_size }
+            , m_owner { std::exchange(other.m_owner, nullptr) }
+            , m_token { other.m_token }
+    {
+    }
+    receive_lease& operator=(receive_lease&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_owner = std::exchange(other.m_owner, nullptr);
+            m_token = other.m_token;
+        }
+        return *this;
+    }
+
+    const unsigned char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    explicit operator bool() const { return m_owner != nullptr; }
+
+    inline void release();
+
+private:
+    const unsigned char* m_data = nullptr;
+    std::size_t m_size = 0;
+    link* m_owner = nullptr;
+    std::uintptr_t m_token = 0;
+};
+
+/*
+ * Packet oriented SpaceWire link.
+ * send() must be safe to call concurrently from several threads, receive() is only called
+ * from one thread at a time.
+ */
+class link
+{
+public:
+    link() = default;
+    link(link&&) = default;
+    link& operator=(link&&) = default;
+    virtual ~link() = default;
+
+    /*
+     * Sends one packet made of the concatenation of count buffers.
+     */
+    virtual bool send(const const_buffer* buffers, std::size_t count) = 0;
+
+    /*
+     * Waits up to timeout for one packet and copies it into buffer.
+     * Returns the packet size, which is larger than capacity when the packet was truncated, 0
+     * on timeout and std::nullopt when the link is closed or broken.
+     */
+    virtual std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout)
+        = 0;
+
+    bool send(const unsigned char* packet, std::size_t size)
+    {
+        const const_buffer buffer { packet, size };
+        return send(&buffer, 1);
+    }
+
+    /*
+     * Sends count packets, each one a single buffer, stopping at the first failure.
+     * Returns the number of packets sent. Links override it to send them with fewer calls.
+     */
+    virtual std::size_t send_packets(const const_buffer* packets, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (!send(&packets[i], 1))
+                return i;
+        }
+        return count;
+    }
+
+    /*
+     * Waits up to timeout for a first packet then takes the packets already pending, up to
+     * count, without waiting again. sizes[i] is set to the size of the packet copied into
+     * buffers[i], following the same truncation rule as receive().
+     * Returns the number of packets received, 0 on timeout and std::nullopt when the link is
+     * closed and nothing was received.
+     */
+    virtual std::optional<std::size_t> receive_packets(const mutable_buffer* buffers,
+        std::size_t* sizes, std::size_t count, std::chrono::milliseconds timeout)
+    {
+        std::size_t received = 0;
+        while (received < count)
+        {
+            const auto size = receive(buffers[received].data, buffers[received].size,
+                received ? std::chrono::milliseconds { 0 } : timeout);
+            if (!size)
+                return received ? std::optional<std::size_t> { received } : std::nullopt;
+            if (*size == 0)
+                break;
+            sizes[received++] = *size;
+        }
+        return received;
+    }
+
+    /*
+     * Waits up to timeout for one packet and lends it, without copying when the link can.
+     * Returns an empty lease on timeout and std::nullopt when the link is closed.
+     * The default receives into a buffer of the link of default_lease_capacity bytes, so only
+     * one such lease may be held at a time and longer packets are truncated.
+     */
+    virtual std::optional<receive_lease> lease(std::chrono::milliseconds timeout)
+    {
+        m_lease_buffer.resize(default_lease_capacity);
+        const auto size = receive(m_lease_buffer.data(), std::size(m_lease_buffer), timeout);
+        if (!size)
+            return std::nullopt;
+        if (*size == 0)
+            return receive_lease {};
+        return receive_lease { m_lease_buffer.data(),
+            std::min(*size, std::size(m_lease_buffer)), this };
+    }
+
+    /*
+     * Links able to look at a pending packet without consuming it return true, peek() then
+     * receive_scatter() can receive a payload straight into a destination chosen from its header.
+     */
+    virtual bool can_peek() const { return false; }
+
+    /*
+     * Waits up to timeout for one packet and copies its first bytes into buffer, leaving it
+     * pending. Returns like receive(), links that cannot peek return std::nullopt.
+     */
+    virtual std::optional<std::size_t> peek(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout)
+    {
+        (void)buffer;
+        (void)capacity;
+        (void)timeout;
+        return std::nullopt;
+    }
+
+    /*
+     * Waits up to timeout for one packet and receives it scattered in order over count buffers.
+     * Returns like receive(), the size being larger than the buffers total when truncated.
+     * The default receives into a buffer of the link and copies the pieces out.
+     */
+    virtual std::optional<std::size_t> receive_scatter(
+        const mutable_buffer* buffers, std::size_t count, std::chrono::milliseconds timeout)
+    {
+        std::size_t capacity = 0;
+        for (std::size_t i = 0; i < count; i++)
+            capacity += buffers[i].size;
+        m_scatter_buffer.resize(capacity);
+        const auto size = receive(m_scatter_buffer.data(), capacity, timeout);
+        if (size && *size)
+            scatter(m_scatter_buffer.data(), std::min(*size, capacity), buffers, count);
+        return size;
+    }
+
+    /*
+     * Emits a time-code on the link, links that cannot carry time-codes return false.
+     */
+    virtual bool send_time_code(time_code code)
+    {
+        (void)code;
+        return false;
+    }
+
+    /*
+     * Link events (received time-codes, state changes and errors) are published to events,
+     * which must outlive the link or be detached with set_event_channel(nullptr).
+     * Packets are not published here, see timestamped_link.
+     */
+    virtual void set_event_channel(event_channel* events) { m_events = events; }
+
+    static constexpr std::size_t default_lease_capacity = 1 << 16;
+
+protected:
+    friend class receive_lease;
+
+    void publish(const link_event& event)
+    {
+        if (m_events)
+            m_events->publish(event);
+    }
+
+    /*
+     * Gives back the packet lent with token, may be called from any thread.
+     */
+    virtual void release(std::uintptr_t token) { (void)token; }
+
+    static void scatter(const unsigned char* packet, std::size_t size,
+        const mutable_buffer* buffers, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count && size; i++)
+        {
+            const std::size_t n = std::min(size, buffers[i].size);
+            std::memcpy(buffers[i].data, packet, n);
+            packet += n;
+            size -= n;
+        }
+    }
+
+private:
+    event_channel* m_events = nullptr;
+    std::vector<unsigned char> m_lease_buffer;
+    std::vector<unsigned char> m_scatter_buffer;
+};
+
+inline void receive_lease::release()
+{
+    if (m_owner)
+        std::exchange(m_owner, nullptr)->release(m_token);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+/*
+ * In-process link, each endpoint receives what its peer sends.
+ * A default constructed loopback_link is its own peer.
+ */
+class loopback_link : public link
+{
+    struct queue
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::vector<unsigned char>> packets;
+        // events of the endpoint receiving from this queue
+        event_channel* events = nullptr;
+        bool closed = false;
+    };
+
+public:
+    loopback_link() : m_in { std::make_shared<queue>() }, m_out { m_in } { }
+    ~loopback_link() override { close(); }
+
+    loopback_link(loopback_link&&) = default;
+    loopback_link& operator=(loopback_link&&) = default;
+
+    static std::pair<loopback_link, loopback_link> make_pair()
+    {
+        auto a = std::make_shared<queue>();
+        auto b = std::make_shared<queue>();
+        return { loopback_link { a, b }, loopback_link { b, a } };
+    }
+
+    using link::send;
+    bool send(const const_buffer* buffers, std::size_t count) override
+    {
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < count; i++)
+            size += buffers[i].size;
+        std::vector<unsigned char> packet(size);
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::memcpy(packet.data() + offset, buffers[i].data, buffers[i].size);
+            offset += buffers[i].size;
+        }
+        {
+            std::lock_guard<std::mutex> lock { m_out->mutex };
+            if (m_out->closed)
+                return false;
+            m_out->packets.push_back(std::move(packet));
+        }
+        m_out->cv.notify_one();
+        return true;
+    }
+
+    std::size_t send_packets(const const_buffer* packets, std::size_t count) override
+    {
+        std::vector<std::vector<unsigned char>> copies(count);
+        for (std::size_t i = 0; i < count; i++)
+            copies[i].assign(packets[i].data, packets[i].data + packets[i].size);
+        {
+            std::lock_guard<std::mutex> lock { m_out->mutex };
+            if (m_out->closed)
+                return 0;
+            for (auto& packet : copies)
+                m_out->packets.push_back(std::move(packet));
+        }
+        m_out->cv.notify_one();
+        return count;
+    }
+
+    std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        std::unique_lock<std::mutex> lock { m_in->mutex };
+        if (!m_in->cv.wait_for(
+                lock, timeout, [this]() { return !m_in->packets.empty() || m_in->closed; }))
+            return 0;
+        if (m_in->packets.empty())
+            return std::nullopt;
+        auto packet = std::move(m_in->packets.front());
+        m_in->packets.pop_front();
+        lock.unlock();
+        std::memcpy(buffer, packet.data(), std::min(capacity, std::size(packet)));
+        return std::size(packet);
+    }
+
+    std::optional<std::size_t> receive_packets(const mutable_buffer* buffers,
+        std::size_t* sizes, std::size_t count, std::chrono::milliseconds timeout) override
+    {
+        std::unique_lock<std::mutex> lock { m_in->mutex };
+        if (!m_in->cv.wait_for(
+                lock, timeout, [this]() { return !m_in->packets.empty() || m_in->closed; }))
+            return 0;
+        if (m_in->packets.empty())
+            return std::nullopt;
+        std::size_t received = 0;
+        for (; received < count && !m_in->packets.empty(); received++)
+        {
+            const auto& packet = m_in->packets.front();
+            std::memcpy(buffers[received].data, packet.data(),
+                std::min(buffers[received].size, std::size(packet)));
+            sizes[received] = std::size(packet);
+            m_in->packets.pop_front();
+        }
+        return received;
+    }
+
+    /*
+     * Lends the queued packet itself, several leases may be held at once.
+     */
+    std::optional<receive_lease> lease(std::chrono::milliseconds timeout) override
+    {
+        std::unique_lock<std::mutex> lock { m_in->mutex };
+        if (!m_in->cv.wait_for(
+                lock, timeout, [this]() { return !m_in->packets.empty() || m_in->closed; }))
+            return receive_lease {};
+        if (m_in->packets.empty())
+            return std::nullopt;
+        const auto token = ++m_last_token;
+        m_leased.emplace_back(token, std::move(m_in->packets.front()));
+        m_in->packets.pop_front();
+        const auto& packet = m_leased.back().second;
+        return receive_lease { packet.data(), std::size(packet), this, token };
+    }
+
+    bool can_peek() const override { return true; }
+
+    std::optional<std::size_t> peek(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        std::unique_lock<std::mutex> lock { m_in->mutex };
+        if (!m_in->cv.wait_for(
+                lock, timeout, [this]() { return !m_in->packets.empty() || m_in->closed; }))
+            return 0;
+        if (m_in->packets.empty())
+            return std::nullopt;
+        const auto& packet = m_in->packets.front();
+        std::memcpy(buffer, packet.data(), std::min(capacity, std::size(packet)));
+        return std::size(packet);
+    }
+
+    std::optional<std::size_t> receive_scatter(const mutable_buffer* buffers, std::size_t count,
+        std::chrono::milliseconds timeout) override
+    {
+        std::unique_lock<std::mutex> lock { m_in->mutex };
+        if (!m_in->cv.wait_for(
+                lock, timeout, [this]() { return !m_in->packets.empty() || m_in->closed; }))
+            return 0;
+        if (m_in->packets.empty())
+            return std::nullopt;
+        auto packet = std::move(m_in->packets.front());
+        m_in->packets.pop_front();
+        lock.unlock();
+        scatter(packet.data(), std::size(packet), buffers, count);
+        return std::size(packet);
+    }
+
+    /*
+     * Time-codes are delivered to the peer event channel, stamped when sent.
+     */
+    bool send_time_code(time_code code) override
+    {
+        std::lock_guard<std::mutex> lock { m_out->mutex };
+        if (m_out->closed)
+            return false;
+        if (m_out->events)
+            m_out->events->publish(link_event::time_code_event(
+                event_kind::time_code_received, timestamp_clock::now(), code));
+        return true;
+    }
+
+    void set_event_channel(event_channel* events) override
+    {
+        {
+            std::lock_guard<std::mutex> lock { m_in->mutex };
+            m_in->events = events;
+        }
+        link::set_event_channel(events);
+    }
+
+    /*
+     * Closes both directions, pending and future receive() calls on both endpoints return
+     * std::nullopt once queued packets are drained. Both endpoints publish a state change to
+     * error_reset.
+     */
+    void close()
+    {
+        for (auto& q : { m_in, m_out })
+        {
+            if (!q)
+                continue;
+            {
+                std::lock_guard<std::mutex> lock { q->mutex };
+                if (!q->closed && q->events)
+                    q->events->publish(
+                        link_event::state_event(timestamp_clock::now(), link_state::error_reset));
+                q->closed = true;
+            }
+            q->cv.notify_all();
+        }
+    }
+
+private:
+    loopback_link(std::shared_ptr<queue> in, std::shared_ptr<queue> out)
+            : m_in { std::move(in) }, m_out { std::move(out) }
+    {
+    }
+
+    void release(std::uintptr_t token) override
+    {
+        // freed once the lock is released
+        std::vector<unsigned char> packet;
+        {
+            std::lock_guard<std::mutex> lock { m_in->mutex };
+            auto it = std::find_if(std::begin(m_leased), std::end(m_leased),
+                [token](const auto& leased) { return leased.first == token; });
+            if (it == std::end(m_leased))
+                return;
+            packet = std::move(it->second);
+            *it = std::move(m_leased.back());
+            m_leased.pop_back();
+        }
+    }
+
+    std::shared_ptr<queue> m_in;
+    std::shared_ptr<queue> m_out;
+    // packets lent by lease(), guarded by m_in->mutex
+    std::vector<std::pair<std::uintptr_t, std::vector<unsigned char>>> m_leased;
+    std::uintptr_t m_last_token = 0;
+};
+
+}
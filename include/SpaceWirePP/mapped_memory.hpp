@@ -0,0 +1,136 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include <cstddef>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace spacewire::rmap
+{
+
+#if __has_include(<sys/mman.h>)
+/*
+ * Owning memory mapping, either anonymous or backed by a file which is created or resized to
+ * the requested size, or a read only view of an existing file. A failed mapping evaluates to
+ * false.
+ */
+class mapped_memory
+{
+public:
+    mapped_memory() = default;
+    ~mapped_memory() { unmap(); }
+
+    mapped_memory(mapped_memory&& other) noexcept
+            : m_data { std::exchange(other.m_data, nullptr) }
+            , m_size { std::exchange(other.m_size, 0) }
+    {
+    }
+    mapped_memory& operator=(mapped_memory&& other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    static mapped_memory anonymous(std::size_t size)
+    {
+        return mapped_memory {
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0), size
+        };
+    }
+
+    static mapped_memory file(const char* path, std::size_t size)
+    {
+        const int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return {};
+        void* data = MAP_FAILED;
+        if (::ftruncate(fd, static_cast<off_t>(size)) == 0)
+            data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        return mapped_memory { data, size };
+    }
+
+    /*
+     * Maps the whole file read only, writing through data() is undefined.
+     * Empty files cannot be mapped.
+     */
+    static mapped_memory read_only(const char* path)
+    {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return {};
+        void* data = MAP_FAILED;
+        std::size_t size = 0;
+        if (const off_t end = ::lseek(fd, 0, SEEK_END); end > 0)
+        {
+            size = static_cast<std::size_t>(end);
+            data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        return mapped_memory { data, size };
+    }
+
+    /*
+     * Hints the kernel about the access pattern, sequential scans get a larger read ahead.
+     */
+    void advise(bool sequential) const
+    {
+        if (m_data)
+            ::madvise(m_data, m_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+
+    unsigned char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    explicit operator bool() const { return m_data != nullptr; }
+
+private:
+    mapped_memory(void* data, std::size_t size)
+    {
+        if (data != MAP_FAILED)
+        {
+            m_data = static_cast<unsigned char*>(data);
+            m_size = size;
+        }
+    }
+
+    void unmap()
+    {
+        if (m_data)
+            ::munmap(std::exchange(m_data, nullptr), m_size);
+    }
+
+    unsigned char* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+#endif
+
+}
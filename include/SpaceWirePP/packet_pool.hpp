@@ -0,0 +1,127 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "freelist.hpp"
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace spacewire
+{
+
+/*
+ * Fixed-size pool of packet buffers allocated once at construction, acquiring and releasing a
+ * slot never allocates and is lock-free. Slots are cache-line aligned and padded so two slots
+ * never share a cache line.
+ * The pool must outlive every handle acquired from it.
+ */
+class packet_pool
+{
+    struct aligned_delete
+    {
+        void operator()(unsigned char* ptr) const
+        {
+            ::operator delete[](ptr, std::align_val_t { packet_pool::alignment });
+        }
+    };
+
+public:
+    static constexpr std::size_t alignment = 64;
+
+    class handle
+    {
+    public:
+        handle() = default;
+        handle(const handle&) = delete;
+        handle& operator=(const handle&) = delete;
+        handle(handle&& other) noexcept : m_pool { other.m_pool }, m_slot { other.m_slot }
+        {
+            other.m_pool = nullptr;
+        }
+        handle& operator=(handle&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                m_pool = other.m_pool;
+                m_slot = other.m_slot;
+                other.m_pool = nullptr;
+            }
+            return *this;
+        }
+        ~handle() { release(); }
+
+        unsigned char* data() const { return m_pool->slot(m_slot); }
+        std::size_t size() const { return m_pool->slot_size(); }
+        explicit operator bool() const { return m_pool != nullptr; }
+
+        void release()
+        {
+            if (m_pool)
+            {
+                m_pool->m_free.push(m_slot);
+                m_pool = nullptr;
+            }
+        }
+
+    private:
+        friend class packet_pool;
+        handle(packet_pool* pool, uint32_t slot) : m_pool { pool }, m_slot { slot } { }
+        packet_pool* m_pool = nullptr;
+        uint32_t m_slot = 0;
+    };
+
+    packet_pool(std::size_t slot_size, std::size_t slot_count)
+            : m_slot_size { slot_size }
+            , m_stride { (slot_size + alignment - 1) / alignment * alignment }
+            , m_storage { static_cast<unsigned char*>(
+                  ::operator new[](m_stride* slot_count, std::align_val_t { alignment })) }
+            , m_free { slot_count }
+    {
+    }
+
+    packet_pool(const packet_pool&) = delete;
+    packet_pool& operator=(const packet_pool&) = delete;
+
+    /*
+     * Returns an empty handle when every slot is in use.
+     */
+    handle acquire()
+    {
+        if (auto slot = m_free.pop(); slot)
+            return handle { this, *slot };
+        return {};
+    }
+
+    std::size_t slot_size() const { return m_slot_size; }
+    std::size_t slot_count() const { return m_free.capacity(); }
+
+private:
+    unsigned char* slot(uint32_t index) const { return m_storage.get() + index * m_stride; }
+
+    std::size_t m_slot_size;
+    std::size_t m_stride;
+    std::unique_ptr<unsigned char[], aligned_delete> m_storage;
+    index_freelist m_free;
+};
+
+}
@@ -0,0 +1,165 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "crc.hpp"
+#include "rmap.hpp"
+#include <array>
+#include <cstring>
+
+namespace spacewire::rmap
+{
+
+/*
+ * Pre-encoded RMAP command for requests sent over and over with only the transaction
+ * identifier, and possibly the address, changing.
+ *
+ * Static fields are encoded once, at compile time when the template is constexpr. Building a
+ * packet copies the 16 bytes header, patches the transaction identifier and address and
+ * updates the header CRC from a precomputed value: since the CRC is linear, the contribution
+ * of each patched byte is a single table lookup, so the cost does not depend on the header.
+ */
+template <typename packet_type>
+class packet_template
+{
+    static_assert(cpp_utils::types::detectors::is_any_of_v<packet_type, rmap_read_cmd_tag,
+                      rmap_write_cmd_tag>,
+        "packet_template only supports read and write commands");
+    static constexpr bool is_write = std::is_same_v<packet_type, rmap_write_cmd_tag>;
+    static constexpr std::size_t crc_size = request_header_size() - 1;
+
+public:
+    constexpr packet_template(unsigned char destination_logical_address,
+        unsigned char destination_key, unsigned char source_logical_address, uint32_t address,
+        uint32_t data_length)
+            : m_header { destination_logical_address,
+                static_cast<unsigned char>(protocol_id_t::SPW_PROTO_ID_RMAP),
+                is_write ? 0b01101100 : 0b01001100, destination_key, source_logical_address, 0,
+                0, 0, 0, 0, 0, 0, static_cast<unsigned char>(data_length >> 16),
+                static_cast<unsigned char>(data_length >> 8),
+                static_cast<unsigned char>(data_length), 0 }
+            , m_data_length { data_length }
+    {
+        m_base_crc = static_crc(m_header.data(), crc_size);
+        m_header[8] = static_cast<unsigned char>(address >> 24);
+        m_header[9] = static_cast<unsigned char>(address >> 16);
+        m_header[10] = static_cast<unsigned char>(address >> 8);
+        m_header[11] = static_cast<unsigned char>(address);
+        m_header[15] = static_crc(m_header.data(), crc_size);
+    }
+
+    constexpr const std::array<unsigned char, request_header_size()>& header() const
+    {
+        return m_header;
+    }
+    constexpr uint32_t data_length() const { return m_data_length; }
+    constexpr std::size_t packet_size() const
+    {
+        return is_write ? write_request_buffer_size(m_data_length) : read_request_buffer_size();
+    }
+
+    /*
+     * Writes the header with the template address, buffer must be at least
+     * request_header_size() bytes long.
+     */
+    void build_header(uint16_t transaction_id, unsigned char* buffer) const
+    {
+        std::memcpy(buffer, m_header.data(), std::size(m_header));
+        buffer[5] = static_cast<unsigned char>(transaction_id >> 8);
+        buffer[6] = static_cast<unsigned char>(transaction_id);
+        buffer[15] = m_header[15] ^ contribution(5, buffer[5]) ^ contribution(6, buffer[6]);
+        instrumentation::packet_built(packet_size());
+    }
+
+    void build_header(uint16_t transaction_id, uint32_t address, unsigned char* buffer) const
+    {
+        std::memcpy(buffer, m_header.data(), std::size(m_header));
+        buffer[5] = static_cast<unsigned char>(transaction_id >> 8);
+        buffer[6] = static_cast<unsigned char>(transaction_id);
+        buffer[8] = static_cast<unsigned char>(address >> 24);
+        buffer[9] = static_cast<unsigned char>(address >> 16);
+        buffer[10] = static_cast<unsigned char>(address >> 8);
+        buffer[11] = static_cast<unsigned char>(address);
+        buffer[15] = m_base_crc ^ contribution(5, buffer[5]) ^ contribution(6, buffer[6])
+            ^ contribution(8, buffer[8]) ^ contribution(9, buffer[9])
+            ^ contribution(10, buffer[10]) ^ contribution(11, buffer[11]);
+        instrumentation::packet_built(packet_size());
+    }
+
+    /*
+     * Read command builders, buffer must be at least packet_size() bytes long.
+     * They return the packet size.
+     */
+    template <bool enable = !is_write, typename = std::enable_if_t<enable>>
+    std::size_t build(uint16_t transaction_id, unsigned char* buffer) const
+    {
+        build_header(transaction_id, buffer);
+        return request_header_size();
+    }
+
+    template <bool enable = !is_write, typename = std::enable_if_t<enable>>
+    std::size_t build(uint16_t transaction_id, uint32_t address, unsigned char* buffer) const
+    {
+        build_header(transaction_id, address, buffer);
+        return request_header_size();
+    }
+
+    /*
+     * Write command builders, data must be data_length() bytes long and buffer at least
+     * packet_size() bytes long. They return the packet size.
+     */
+    template <bool enable = is_write, typename = std::enable_if_t<enable>>
+    std::size_t build(
+        uint16_t transaction_id, const unsigned char* data, unsigned char* buffer) const
+    {
+        build_header(transaction_id, buffer);
+        return write_data(data, buffer);
+    }
+
+    template <bool enable = is_write, typename = std::enable_if_t<enable>>
+    std::size_t build(uint16_t transaction_id, uint32_t address, const unsigned char* data,
+        unsigned char* buffer) const
+    {
+        build_header(transaction_id, address, buffer);
+        return write_data(data, buffer);
+    }
+
+private:
+    // CRC contribution of byte value at position in the CRC'd part of the header
+    static unsigned char contribution(std::size_t position, unsigned char value)
+    {
+        return spacewire::details::crc::SliceTables[crc_size - 1 - position][value];
+    }
+
+    std::size_t write_data(const unsigned char* data, unsigned char* buffer) const
+    {
+        std::memcpy(buffer + request_header_size(), data, m_data_length);
+        buffer[request_header_size() + m_data_length] = spacewire::crc(data, m_data_length);
+        return write_request_buffer_size(m_data_length);
+    }
+
+    std::array<unsigned char, request_header_size()> m_header;
+    uint32_t m_data_length;
+    // header CRC with transaction identifier and address set to 0
+    unsigned char m_base_crc = 0;
+};
+
+}
@@ -0,0 +1,338 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "rmap.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace spacewire::rmap
+{
+
+enum class packet_kind : unsigned char
+{
+    invalid,
+    read_command,
+    write_command,
+    read_reply,
+    write_reply,
+    rmw_command,
+    rmw_reply
+};
+
+enum class packet_error : unsigned char
+{
+    none,
+    too_short,
+    not_rmap,
+    invalid_packet_type,
+    header_crc,
+    early_eop,
+    too_much_data,
+    data_crc
+};
+
+inline constexpr packet_kind classify_packet_type(unsigned char packet_type)
+{
+    if (packet_type & 0b10000000)
+        return packet_kind::invalid;
+    const unsigned char command = (packet_type >> 2) & 0b1111;
+    if (packet_type & 0b01000000)
+    {
+        if (command & 0b1000)
+            return packet_kind::write_command;
+        if ((command & 0b1110) == 0b0010)
+            return packet_kind::read_command;
+        if (command == 0b0111)
+            return packet_kind::rmw_command;
+        return packet_kind::invalid;
+    }
+    if ((command & 0b1010) == 0b1010)
+        return packet_kind::write_reply;
+    if ((command & 0b1110) == 0b0010)
+        return packet_kind::read_reply;
+    if (command == 0b0111)
+        return packet_kind::rmw_reply;
+    return packet_kind::invalid;
+}
+
+/*
+ * Validating, non owning view of an RMAP packet.
+ * The constructor classifies the packet, checks its size against the header and data length
+ * fields and both CRCs, reading every byte exactly once and never past packet + size.
+ * Decoded fields are stored as plain values, accessors do not touch the packet again.
+ *
+ * Fields meaning depends on the packet kind:
+ *  - destination/source logical addresses are the target/initiator for commands and the
+ *    initiator/target for replies,
+ *  - key() is only meaningful for commands and status() for replies,
+ *  - address(), extended_address() and full_address() are only meaningful for commands,
+ *  - data() is only meaningful for write and read-modify-write commands and for read and
+ *    read-modify-write replies, the latter carrying data followed by mask.
+ */
+class packet_view
+{
+public:
+    struct deferred_data_crc_t
+    {
+    };
+    static constexpr deferred_data_crc_t deferred_data_crc {};
+
+    packet_view() = default;
+    packet_view(const unsigned char* packet, std::size_t size) noexcept
+            : m_packet { packet }, m_size { size }
+    {
+        decode(size, nullptr);
+        if constexpr (instrumentation::enabled)
+            instrument();
+    }
+    /*
+     * Checks everything but the data CRC, which is left to copy_data() or check_data_crc() so a
+     * payload copied out of the packet is read once. valid() does not cover the data CRC.
+     */
+    packet_view(const unsigned char* packet, std::size_t size, deferred_data_crc_t) noexcept
+            : m_packet { packet }, m_size { size }, m_data_crc_deferred { true }
+    {
+        decode(size, nullptr);
+        if constexpr (instrumentation::enabled)
+            instrument();
+    }
+    /*
+     * View of a packet with data received in pieces: header_size bytes of header, the data
+     * somewhere else and its CRC, as when a payload is received straight into its destination.
+     */
+    packet_view(const unsigned char* header, std::size_t header_size, const unsigned char* data,
+        std::size_t data_size, unsigned char data_crc) noexcept
+            : m_packet { header }, m_size { header_size + data_size + 1 }, m_placed_data { data }
+    {
+        decode(header_size, &data_crc);
+        if constexpr (instrumentation::enabled)
+            instrument();
+    }
+    // Skips path_size leading path address bytes, for packets captured before being routed
+    packet_view(const unsigned char* packet, std::size_t size, std::size_t path_size) noexcept
+            : packet_view(packet + std::min(path_size, size), size - std::min(path_size, size))
+    {
+    }
+
+    packet_kind kind() const noexcept { return m_kind; }
+    packet_error error() const noexcept { return m_error; }
+    bool valid() const noexcept { return m_error == packet_error::none; }
+    explicit operator bool() const noexcept { return valid(); }
+
+    bool is_command() const noexcept
+    {
+        return m_kind == packet_kind::read_command || m_kind == packet_kind::write_command
+            || m_kind == packet_kind::rmw_command;
+    }
+    bool is_reply() const noexcept
+    {
+        return m_kind == packet_kind::read_reply || m_kind == packet_kind::write_reply
+            || m_kind == packet_kind::rmw_reply;
+    }
+    bool has_data() const noexcept
+    {
+        return m_kind == packet_kind::write_command || m_kind == packet_kind::read_reply
+            || m_kind == packet_kind::rmw_command || m_kind == packet_kind::rmw_reply;
+    }
+
+    const unsigned char* packet() const noexcept { return m_packet; }
+    std::size_t size() const noexcept { return m_size; }
+
+    unsigned char destination_logical_address() const noexcept { return m_destination; }
+    unsigned char source_logical_address() const noexcept { return m_source; }
+    unsigned char packet_type() const noexcept { return m_packet_type; }
+    unsigned char key() const noexcept { return m_key_or_status; }
+    status_t status() const noexcept { return static_cast<status_t>(m_key_or_status); }
+    uint16_t transaction_id() const noexcept { return m_transaction_id; }
+    unsigned char extended_address() const noexcept { return m_extended_address; }
+    uint32_t address() const noexcept { return m_address; }
+    // 40 bits address, extended address included
+    uint64_t full_address() const noexcept
+    {
+        return (uint64_t { m_extended_address } << 32) | m_address;
+    }
+    uint32_t data_length() const noexcept { return m_data_length; }
+
+    bool verify() const noexcept { return m_packet_type & 0b00010000; }
+    bool acknowledge() const noexcept { return m_packet_type & 0b00001000; }
+    bool increment() const noexcept { return m_packet_type & 0b00000100; }
+
+    const unsigned char* reply_address() const noexcept { return m_packet + 4; }
+    std::size_t reply_address_size() const noexcept { return m_reply_address_size; }
+
+    std::size_t header_size() const noexcept { return m_header_size; }
+    const unsigned char* data() const noexcept
+    {
+        return m_placed_data ? m_placed_data : m_packet + m_header_size;
+    }
+    unsigned char data_crc() const noexcept { return m_data_crc; }
+
+    bool header_crc_valid() const noexcept { return m_header_crc_valid; }
+    bool data_crc_valid() const noexcept { return m_data_crc_valid; }
+    bool data_crc_deferred() const noexcept { return m_data_crc_deferred; }
+
+    /*
+     * Check the data CRC for views built with deferred_data_crc, copy_data() also copies the
+     * data to destination in the same pass. Both are only meaningful on valid views with data.
+     */
+    bool check_data_crc() const noexcept
+    {
+        return spacewire::crc(data(), m_data_length) == m_data_crc;
+    }
+    bool copy_data(unsigned char* destination) const noexcept
+    {
+        return spacewire::crc_copy(destination, data(), m_data_length) == m_data_crc;
+    }
+
+private:
+    static constexpr uint32_t be16(const unsigned char* p) { return (p[0] << 8) | p[1]; }
+    static constexpr uint32_t be24(const unsigned char* p)
+    {
+        return (uint32_t { p[0] } << 16) | (uint32_t { p[1] } << 8) | p[2];
+    }
+    static constexpr uint32_t be32(const unsigned char* p)
+    {
+        return (uint32_t { p[0] } << 24) | be24(p + 1);
+    }
+
+    void instrument() const noexcept
+    {
+        instrumentation::packet_parsed(m_size, m_error == packet_error::header_crc,
+            m_header_crc_valid && has_data() && m_error != packet_error::early_eop
+                && !m_data_crc_valid && !m_data_crc_deferred);
+        if (is_reply() && m_header_crc_valid)
+            instrumentation::status(m_key_or_status);
+    }
+
+    void fail(packet_error error) noexcept
+    {
+        m_error = error;
+        if (error == packet_error::too_short || error == packet_error::not_rmap
+            || error == packet_error::invalid_packet_type)
+            m_kind = packet_kind::invalid;
+    }
+
+    /*
+     * header_bytes bytes are readable at m_packet, the data and its CRC follow them unless
+     * placed_crc is given, the data is then at m_placed_data.
+     */
+    void decode(std::size_t header_bytes, const unsigned char* placed_crc) noexcept
+    {
+        const unsigned char* p = m_packet;
+        m_error = packet_error::none;
+        if (header_bytes < 8)
+            return fail(packet_error::too_short);
+        if (p[1] != static_cast<unsigned char>(protocol_id_t::SPW_PROTO_ID_RMAP))
+            return fail(packet_error::not_rmap);
+        m_packet_type = p[2];
+        m_kind = classify_packet_type(m_packet_type);
+        m_destination = p[0];
+        m_key_or_status = p[3];
+        switch (m_kind)
+        {
+            case packet_kind::read_command:
+            case packet_kind::write_command:
+            case packet_kind::rmw_command:
+            {
+                m_reply_address_size = 4 * (m_packet_type & 0b11);
+                m_header_size = 16 + m_reply_address_size;
+                if (header_bytes < m_header_size)
+                    return fail(packet_error::too_short);
+                const unsigned char* h = p + m_reply_address_size;
+                m_source = h[4];
+                m_transaction_id = be16(h + 5);
+                m_extended_address = h[7];
+                m_address = be32(h + 8);
+                m_data_length = be24(h + 12);
+                m_header_crc_valid = spacewire::crc(p, m_header_size - 1) == h[15];
+                break;
+            }
+            case packet_kind::read_reply:
+            case packet_kind::rmw_reply:
+                m_header_size = 12;
+                if (header_bytes < m_header_size)
+                    return fail(packet_error::too_short);
+                m_source = p[4];
+                m_transaction_id = be16(p + 5);
+                m_data_length = be24(p + 8);
+                m_header_crc_valid = spacewire::crc(p, 11) == p[11];
+                break;
+            case packet_kind::write_reply:
+                m_header_size = 8;
+                m_source = p[4];
+                m_transaction_id = be16(p + 5);
+                m_header_crc_valid = spacewire::crc(p, 7) == p[7];
+                break;
+            default:
+                return fail(packet_error::invalid_packet_type);
+        }
+        if (!m_header_crc_valid)
+            return fail(packet_error::header_crc);
+        if (placed_crc && header_bytes > m_header_size)
+            return fail(packet_error::too_much_data);
+        if (!has_data())
+        {
+            if (m_size > m_header_size)
+                return fail(packet_error::too_much_data);
+            m_data_crc_valid = true;
+            return;
+        }
+        const std::size_t expected_size = m_header_size + std::size_t { m_data_length } + 1;
+        if (m_size < expected_size)
+            return fail(packet_error::early_eop);
+        m_data_crc = placed_crc ? *placed_crc : p[expected_size - 1];
+        if (m_data_crc_deferred)
+        {
+            if (m_size > expected_size)
+                fail(packet_error::too_much_data);
+            return;
+        }
+        m_data_crc_valid = check_data_crc();
+        if (m_size > expected_size)
+            return fail(packet_error::too_much_data);
+        if (!m_data_crc_valid)
+            return fail(packet_error::data_crc);
+    }
+
+    const unsigned char* m_packet = nullptr;
+    std::size_t m_size = 0;
+    const unsigned char* m_placed_data = nullptr;
+    std::size_t m_header_size = 0;
+    std::size_t m_reply_address_size = 0;
+    uint32_t m_address = 0;
+    uint32_t m_data_length = 0;
+    uint16_t m_transaction_id = 0;
+    packet_kind m_kind = packet_kind::invalid;
+    packet_error m_error = packet_error::too_short;
+    unsigned char m_destination = 0;
+    unsigned char m_source = 0;
+    unsigned char m_packet_type = 0;
+    unsigned char m_key_or_status = 0;
+    unsigned char m_extended_address = 0;
+    unsigned char m_data_crc = 0;
+    bool m_header_crc_valid = false;
+    bool m_data_crc_valid = false;
+    bool m_data_crc_deferred = false;
+};
+
+}
@@ -0,0 +1,306 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "link.hpp"
+#include "packet_pool.hpp"
+#include "packet_view.hpp"
+#include "ring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace spacewire::rmap
+{
+
+/*
+ * Packet received by a pipeline, view points into the pool slot owned by handle.
+ * Consumers may move handle out to keep the packet, the slot is released when it is destroyed.
+ */
+struct received_packet
+{
+    packet_pool::handle handle;
+    std::size_t size = 0;
+    // receive order, dense for packets reaching the consumer
+    uint64_t sequence = 0;
+    packet_view view;
+};
+
+struct pipeline_config
+{
+    // validation threads, 0 means one per hardware thread minus the reader
+    std::size_t workers = 0;
+    // packets queued per worker
+    std::size_t ring_capacity = 256;
+    // larger packets are dropped
+    std::size_t max_packet_size = 1 << 16;
+    // packets in flight between the link and consumers, including those kept by consumers
+    std::size_t pool_size = 1024;
+    // dispatch in receive order from a single thread, which implies per TID order
+    bool ordered = true;
+    // link receive timeout, also the stop latency
+    std::chrono::milliseconds poll_interval { 10 };
+};
+
+namespace details::pipeline
+{
+    // Spins a few times then yields and finally sleeps, so idle stages do not burn a core
+    class backoff
+    {
+    public:
+        void operator()()
+        {
+            if (m_count < 16)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds { 50 });
+            m_count++;
+        }
+        void reset() { m_count = 0; }
+
+    private:
+        std::size_t m_count = 0;
+    };
+
+    struct work_item
+    {
+        packet_pool::handle handle;
+        std::size_t size = 0;
+        uint64_t sequence = 0;
+    };
+}
+
+/*
+ * Multithreaded receive pipeline: link reader -> classifier -> CRC validation -> dispatch.
+ *
+ *  - the reader thread receives each packet straight into a packet_pool slot, drops oversized
+ *    ones and hands the slot over round robin to the validation workers,
+ *  - each worker owns a lock-free bounded_ring of slot handles and steals from the other rings
+ *    when its own is empty, then decodes the packet with packet_view which checks both CRCs,
+ *  - consumer is called with every packet; when ordered, a single dispatch thread restores the
+ *    receive order through a reorder window indexed by sequence, otherwise workers call it
+ *    concurrently as soon as a packet is validated.
+ *
+ * Packets never get copied after the link receive. When the pool runs out, because consumers
+ * keep too many packets or cannot keep up, the reader stops receiving until a slot is released.
+ * The link must outlive the pipeline.
+ */
+class receive_pipeline
+{
+    using work_item = details::pipeline::work_item;
+
+    struct reorder_cell
+    {
+        std::atomic<bool> ready { false };
+        received_packet packet;
+    };
+
+public:
+    using consumer_t = std::function<void(received_packet&&)>;
+
+    receive_pipeline(spacewire::link& link, consumer_t consumer, pipeline_config config = {})
+            : m_link { link }
+            , m_consumer { std::move(consumer) }
+            , m_config { config }
+            , m_pool { config.max_packet_size, std::max<std::size_t>(config.pool_size, 1) }
+    {
+        std::size_t workers = m_config.workers;
+        if (workers == 0)
+            workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        for (std::size_t i = 0; i < workers; i++)
+            m_rings.push_back(std::make_unique<bounded_ring<work_item>>(m_config.ring_capacity));
+        if (m_config.ordered)
+            m_reorder.reset(new reorder_cell[m_pool.slot_count()]);
+        m_threads.emplace_back(&receive_pipeline::read_loop, this);
+        for (std::size_t i = 0; i < workers; i++)
+            m_threads.emplace_back(&receive_pipeline::worker_loop, this, i);
+        if (m_config.ordered)
+            m_threads.emplace_back(&receive_pipeline::dispatch_loop, this);
+    }
+
+    ~receive_pipeline() { stop(); }
+
+    receive_pipeline(const receive_pipeline&) = delete;
+    receive_pipeline& operator=(const receive_pipeline&) = delete;
+
+    /*
+     * Stops receiving, drains packets already received to the consumer and joins every thread.
+     */
+    void stop()
+    {
+        m_stop.store(true, std::memory_order_relaxed);
+        wait();
+    }
+
+    /*
+     * Blocks until the link is closed and every packet received from it reached the consumer.
+     */
+    void wait()
+    {
+        for (auto& thread : m_threads)
+            if (thread.joinable())
+                thread.join();
+    }
+
+    // true once the reader exited and every received packet reached the consumer
+    bool drained() const
+    {
+        return m_reader_done.load(std::memory_order_acquire)
+            && m_dispatched.load(std::memory_order_acquire)
+            == m_received.load(std::memory_order_acquire);
+    }
+
+    std::size_t workers() const { return std::size(m_rings); }
+    uint64_t received() const { return m_received.load(std::memory_order_relaxed); }
+    uint64_t dispatched() const { return m_dispatched.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    void read_loop()
+    {
+        details::pipeline::backoff wait;
+        std::size_t next_ring = 0;
+        while (!m_stop.load(std::memory_order_relaxed))
+        {
+            auto handle = m_pool.acquire();
+            if (!handle)
+            {
+                wait();
+                continue;
+            }
+            wait.reset();
+            const auto size = m_link.receive(handle.data(), handle.size(), m_config.poll_interval);
+            if (!size)
+                break;
+            if (*size == 0)
+                continue;
+            if (*size > handle.size())
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            work_item item { std::move(handle), *size,
+                m_received.load(std::memory_order_relaxed) };
+            while (!m_rings[next_ring]->try_push(item))
+            {
+                next_ring = (next_ring + 1) % std::size(m_rings);
+                wait();
+            }
+            wait.reset();
+            next_ring = (next_ring + 1) % std::size(m_rings);
+            m_received.fetch_add(1, std::memory_order_release);
+        }
+        m_reader_done.store(true, std::memory_order_release);
+    }
+
+    std::optional<work_item> next_item(std::size_t worker)
+    {
+        const std::size_t count = std::size(m_rings);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (auto item = m_rings[(worker + i) % count]->try_pop(); item)
+                return item;
+        }
+        return std::nullopt;
+    }
+
+    void worker_loop(std::size_t worker)
+    {
+        details::pipeline::backoff wait;
+        for (;;)
+        {
+            // read before looking at the rings, the reader pushes every item before setting it
+            const bool reader_done = m_reader_done.load(std::memory_order_acquire);
+            auto item = next_item(worker);
+            if (!item)
+            {
+                if (reader_done)
+                    break;
+                wait();
+                continue;
+            }
+            wait.reset();
+            received_packet packet { std::move(item->handle), item->size, item->sequence,
+                packet_view {} };
+            packet.view = packet_view { packet.handle.data(), packet.size };
+            if (m_config.ordered)
+            {
+                auto& cell = m_reorder[packet.sequence % m_pool.slot_count()];
+                cell.packet = std::move(packet);
+                cell.ready.store(true, std::memory_order_release);
+            }
+            else
+            {
+                m_consumer(std::move(packet));
+                m_dispatched.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+    /*
+     * A sequence number can only be reused by the reader once its pool slot is released, which
+     * happens after it left the reorder window, so pool_size cells are enough.
+     */
+    void dispatch_loop()
+    {
+        details::pipeline::backoff wait;
+        uint64_t next = 0;
+        for (;;)
+        {
+            const bool reader_done = m_reader_done.load(std::memory_order_acquire);
+            auto& cell = m_reorder[next % m_pool.slot_count()];
+            if (!cell.ready.load(std::memory_order_acquire))
+            {
+                if (reader_done && next == m_received.load(std::memory_order_acquire))
+                    break;
+                wait();
+                continue;
+            }
+            wait.reset();
+            received_packet packet = std::move(cell.packet);
+            cell.ready.store(false, std::memory_order_relaxed);
+            m_consumer(std::move(packet));
+            m_dispatched.fetch_add(1, std::memory_order_release);
+            next++;
+        }
+    }
+
+    spacewire::link& m_link;
+    consumer_t m_consumer;
+    pipeline_config m_config;
+    packet_pool m_pool;
+    std::vector<std::unique_ptr<bounded_ring<work_item>>> m_rings;
+    std::unique_ptr<reorder_cell[]> m_reorder;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stop { false };
+    std::atomic<bool> m_reader_done { false };
+    alignas(64) std::atomic<uint64_t> m_received { 0 };
+    alignas(64) std::atomic<uint64_t> m_dispatched { 0 };
+    std::atomic<uint64_t> m_dropped { 0 };
+};
+
+}
@@ -0,0 +1,138 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace spacewire
+{
+
+/*
+ * Lock-free bounded ring buffer, safe for any number of concurrent producers and consumers
+ * (D. Vyukov's bounded MPMC queue). Each cell carries a sequence number telling whether it is
+ * ready to be written or read for the current lap, so producers and consumers only contend on
+ * their own index and never wait for each other while the ring is neither full nor empty.
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class bounded_ring
+{
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+public:
+    explicit bounded_ring(std::size_t capacity)
+            : m_mask { round_up(capacity) - 1 }, m_cells { new cell[m_mask + 1] }
+    {
+        for (std::size_t i = 0; i <= m_mask; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bounded_ring(const bounded_ring&) = delete;
+    bounded_ring& operator=(const bounded_ring&) = delete;
+
+    /*
+     * Returns false and leaves value untouched when the ring is full.
+     */
+    bool try_push(T& value)
+    {
+        std::size_t position = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell& c = m_cells[position & m_mask];
+            const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+            const auto diff
+                = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed))
+                {
+                    c.value = std::move(value);
+                    c.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(T&& value) { return try_push(value); }
+
+    std::optional<T> try_pop()
+    {
+        std::size_t position = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell& c = m_cells[position & m_mask];
+            const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence)
+                - static_cast<std::ptrdiff_t>(position + 1);
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed))
+                {
+                    std::optional<T> value { std::move(c.value) };
+                    c.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    return value;
+                }
+            }
+            else if (diff < 0)
+                return std::nullopt;
+            else
+                position = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Approximate when other threads are pushing or popping
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+    std::size_t capacity() const { return m_mask + 1; }
+
+private:
+    static std::size_t round_up(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    std::size_t m_mask;
+    std::unique_ptr<cell[]> m_cells;
+    alignas(64) std::atomic<std::size_t> m_tail { 0 };
+    alignas(64) std::atomic<std::size_t> m_head { 0 };
+};
+
+}
@@ -71,8 +71,16 @@
  */
 
 #include "SpaceWire.hpp"
+#include "instrumentation.hpp"
 #include "types/detectors.hpp"
 #include <cassert>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#endif
 
 namespace spacewire::rmap
 {
@@ -81,11 +89,66 @@ struct rmap_write_cmd_tag;
 struct rmap_read_cmd_tag;
 struct rmap_read_response_tag;
 struct rmap_write_response_tag;
+struct rmap_rmw_cmd_tag;
+struct rmap_rmw_response_tag;
 
 template <typename packet_type>
 static inline constexpr bool is_packet_type_v
     = cpp_utils::types::detectors::is_any_of_v<packet_type, rmap_read_cmd_tag,
-        rmap_read_response_tag, rmap_write_cmd_tag>;
+        rmap_read_response_tag, rmap_write_cmd_tag, rmap_write_response_tag, rmap_rmw_cmd_tag,
+        rmap_rmw_response_tag>;
+
+/*
+ * Command options, packet type bits of the instruction field.
+ * Reads are always acknowledged, writes accept any combination and read-modify-writes use all
+ * of them. They are template arguments of the builders so invalid combinations fail to
+ * compile and the packet type is a constant.
+ */
+namespace options
+{
+    inline constexpr unsigned char none = 0;
+    inline constexpr unsigned char increment = 0b00000100;
+    inline constexpr unsigned char acknowledge = 0b00001000;
+    inline constexpr unsigned char verify = 0b00010000;
+}
+
+template <unsigned char command_options = options::increment>
+inline constexpr unsigned char read_packet_type()
+{
+    static_assert((command_options & ~(options::increment | options::acknowledge)) == 0,
+        "reads only support the increment option");
+    return 0b01000000 | options::acknowledge | command_options;
+}
+
+template <unsigned char command_options = options::acknowledge | options::increment>
+inline constexpr unsigned char write_packet_type()
+{
+    static_assert(
+        (command_options & ~(options::increment | options::acknowledge | options::verify)) == 0,
+        "unknown write option");
+    return 0b01100000 | command_options;
+}
+
+inline constexpr unsigned char rmw_packet_type()
+{
+    return 0b01000000 | options::verify | options::acknowledge | options::increment;
+}
+
+enum class status_t : unsigned char
+{
+    success = 0,
+    general_error = 1,
+    unused_packet_type = 2,
+    invalid_key = 3,
+    invalid_data_crc = 4,
+    early_eop = 5,
+    too_much_data = 6,
+    eep = 7,
+    verify_buffer_overrun = 9,
+    not_authorised = 10,
+    rmw_data_length_error = 11,
+    invalid_target_logical_address = 12
+};
 
 namespace fields
 {
@@ -95,6 +158,9 @@ namespace fields
     inline unsigned char& destination_key(unsigned char* packet) { return packet[3]; }
     inline const unsigned char& destination_key(const unsigned char* packet) { return packet[3]; }
 
+    inline unsigned char& status(unsigned char* packet) { return packet[3]; }
+    inline const unsigned char& status(const unsigned char* packet) { return packet[3]; }
+
     inline unsigned char& source_logical_address(unsigned char* packet) { return packet[4]; }
     inline const unsigned char& source_logical_address(const unsigned char* packet)
     {
@@ -117,6 +183,12 @@ namespace fields
         return packet[7];
     }
 
+    inline unsigned char& extended_address(unsigned char* packet) { return packet[7]; }
+    inline const unsigned char& extended_address(const unsigned char* packet)
+    {
+        return packet[7];
+    }
+
     inline field_proxy<uint32_t> address(unsigned char* packet) { return { packet + 8 }; }
     inline field_proxy<uint32_t, true> address(const unsigned char* packet)
     {
@@ -128,9 +200,12 @@ namespace fields
     {
         using namespace cpp_utils::types::detectors;
         static_assert(is_packet_type_v<packet_type>, "packet_type must be a valid packet type");
-        if constexpr (is_any_of_v<packet_type, rmap_write_cmd_tag, rmap_read_cmd_tag>)
+        static_assert(!std::is_same_v<packet_type, rmap_write_response_tag>,
+            "write responses have no data length field");
+        if constexpr (
+            is_any_of_v<packet_type, rmap_write_cmd_tag, rmap_read_cmd_tag, rmap_rmw_cmd_tag>)
             return 12;
-        if constexpr (std::is_same_v<packet_type, rmap_read_response_tag>)
+        if constexpr (is_any_of_v<packet_type, rmap_read_response_tag, rmap_rmw_response_tag>)
             return 8;
     }
 
@@ -150,9 +225,10 @@ namespace fields
     {
         using namespace cpp_utils::types::detectors;
         static_assert(is_packet_type_v<packet_type>, "packet_type must be a valid packet type");
-        if constexpr (is_any_of_v<packet_type, rmap_write_cmd_tag, rmap_read_cmd_tag>)
+        if constexpr (
+            is_any_of_v<packet_type, rmap_write_cmd_tag, rmap_read_cmd_tag, rmap_rmw_cmd_tag>)
             return 15;
-        if constexpr (std::is_same_v<packet_type, rmap_read_response_tag>)
+        if constexpr (is_any_of_v<packet_type, rmap_read_response_tag, rmap_rmw_response_tag>)
             return 11;
         if constexpr (std::is_same_v<packet_type, rmap_write_response_tag>)
             return 7;
@@ -172,11 +248,12 @@ namespace fields
     static inline constexpr std::size_t data_offset()
     {
         using namespace cpp_utils::types::detectors;
-        static_assert(is_any_of_v<packet_type, rmap_read_response_tag, rmap_write_cmd_tag>,
+        static_assert(is_any_of_v<packet_type, rmap_read_response_tag, rmap_write_cmd_tag,
+                          rmap_rmw_cmd_tag, rmap_rmw_response_tag>,
             "packet_type must be a valid packet type");
-        if constexpr (is_any_of_v<packet_type, rmap_write_cmd_tag>)
+        if constexpr (is_any_of_v<packet_type, rmap_write_cmd_tag, rmap_rmw_cmd_tag>)
             return 16;
-        if constexpr (std::is_same_v<packet_type, rmap_read_response_tag>)
+        if constexpr (is_any_of_v<packet_type, rmap_read_response_tag, rmap_rmw_response_tag>)
             return 12;
     }
 
@@ -225,6 +302,11 @@ inline bool is_rmap_read_response(const unsigned char* packet)
     return (fields::packet_type(packet) & 0b11111000) == 0b00001000;
 }
 
+inline bool is_rmap_rmw_response(const unsigned char* packet)
+{
+    return (fields::packet_type(packet) & 0b11111100) == 0b00011100;
+}
+
 inline constexpr std::size_t request_header_size()
 {
     return 16;
@@ -237,7 +319,328 @@ inline constexpr std::size_t write_request_buffer_size(std::size_t data_size)
 {
     return request_header_size() + data_size + 1;
 }
+inline constexpr std::size_t write_reply_size()
+{
+    return 8;
+}
+inline constexpr std::size_t read_reply_header_size()
+{
+    return 12;
+}
+inline constexpr std::size_t read_reply_buffer_size(std::size_t data_size)
+{
+    return read_reply_header_size() + data_size + 1;
+}
+// data_size is the size of the accessed word, the command carries data followed by mask
+inline constexpr std::size_t rmw_request_buffer_size(std::size_t data_size)
+{
+    return write_request_buffer_size(2 * data_size);
+}
+inline constexpr std::size_t rmw_reply_buffer_size(std::size_t data_size)
+{
+    return read_reply_buffer_size(data_size);
+}
+
+/*
+ * Layout of a command as sent by the initiator: path address bytes, stripped by the routers
+ * on the way to the target, then the header with the reply address between the key and the
+ * initiator logical address. Offsets are those of a command without path nor reply address,
+ * shifted according to the layout.
+ * static_command_layout resolves them at compile time, command_layout is the runtime fallback
+ * for routes only known at run time.
+ */
+template <std::size_t path_size_v = 0, std::size_t reply_address_size_v = 0>
+struct static_command_layout
+{
+    static_assert(reply_address_size_v % 4 == 0 && reply_address_size_v <= 12,
+        "reply address must be 0, 4, 8 or 12 bytes long");
+
+    static constexpr std::size_t path_size() { return path_size_v; }
+    static constexpr std::size_t reply_address_size() { return reply_address_size_v; }
+    static constexpr std::size_t offset(std::size_t logical_offset)
+    {
+        return path_size_v + logical_offset + (logical_offset > 3 ? reply_address_size_v : 0);
+    }
+    static constexpr std::size_t header_size() { return offset(request_header_size()); }
+};
+
+class command_layout
+{
+public:
+    constexpr command_layout(std::size_t path_size = 0, std::size_t reply_address_size = 0)
+            : m_path_size { path_size }, m_reply_address_size { reply_address_size }
+    {
+        assert(reply_address_size % 4 == 0 && reply_address_size <= 12);
+    }
+    template <std::size_t path_size_v, std::size_t reply_address_size_v>
+    constexpr command_layout(static_command_layout<path_size_v, reply_address_size_v>)
+            : m_path_size { path_size_v }, m_reply_address_size { reply_address_size_v }
+    {
+    }
+
+    constexpr std::size_t path_size() const { return m_path_size; }
+    constexpr std::size_t reply_address_size() const { return m_reply_address_size; }
+    constexpr std::size_t offset(std::size_t logical_offset) const
+    {
+        return m_path_size + logical_offset + (logical_offset > 3 ? m_reply_address_size : 0);
+    }
+    constexpr std::size_t header_size() const { return offset(request_header_size()); }
+
+private:
+    std::size_t m_path_size;
+    std::size_t m_reply_address_size;
+};
+
+template <typename layout_t>
+inline constexpr std::size_t read_request_buffer_size(const layout_t& layout)
+{
+    return layout.header_size();
+}
+template <typename layout_t>
+inline constexpr std::size_t write_request_buffer_size(
+    const layout_t& layout, std::size_t data_size)
+{
+    return layout.header_size() + data_size + 1;
+}
+
+/*
+ * Field accessors of a command laid out as layout_t, byte_t is const qualified for read only
+ * access. With a static_command_layout every offset is a constant.
+ */
+template <typename layout_t = static_command_layout<>, typename byte_t = unsigned char>
+class command_view
+{
+    static constexpr bool is_const = std::is_const_v<byte_t>;
+
+public:
+    constexpr command_view(byte_t* packet, layout_t layout = {})
+            : m_packet { packet }, m_layout { layout }
+    {
+    }
+
+    constexpr const layout_t& layout() const { return m_layout; }
+    byte_t* path() const { return m_packet; }
+    byte_t* header() const { return m_packet + m_layout.path_size(); }
+    byte_t& destination_logical_address() const { return m_packet[m_layout.offset(0)]; }
+    byte_t& protocol_identifier() const { return m_packet[m_layout.offset(1)]; }
+    byte_t& packet_type() const { return m_packet[m_layout.offset(2)]; }
+    byte_t& destination_key() const { return m_packet[m_layout.offset(3)]; }
+    byte_t* reply_address() const { return m_packet + m_layout.offset(3) + 1; }
+    byte_t& source_logical_address() const { return m_packet[m_layout.offset(4)]; }
+    field_proxy<uint16_t, is_const> transaction_id() const
+    {
+        return { m_packet + m_layout.offset(5) };
+    }
+    byte_t& extended_address() const { return m_packet[m_layout.offset(7)]; }
+    field_proxy<uint32_t, is_const> address() const { return { m_packet + m_layout.offset(8) }; }
+    field_proxy<uint24_t, is_const> data_length() const
+    {
+        return { m_packet + m_layout.offset(12) };
+    }
+    byte_t& header_crc() const { return m_packet[m_layout.offset(15)]; }
+    byte_t* data() const { return m_packet + m_layout.header_size(); }
+    byte_t& data_crc() const { return data()[uint24_t(data_length()).value]; }
+
+    bool header_crc_valid() const
+    {
+        return header_crc()
+            == spacewire::crc(header(), m_layout.header_size() - m_layout.path_size() - 1);
+    }
+    bool data_crc_valid() const
+    {
+        return data_crc() == spacewire::crc(data(), uint24_t(data_length()).value);
+    }
+
+private:
+    byte_t* m_packet;
+    layout_t m_layout;
+};
+
+/*
+ * Routing of a command: path address bytes prepended to the packet and reply path used by the
+ * target to send the reply back. The reply address field is the reply path padded with
+ * leading zeros to 4, 8 or 12 bytes.
+ */
+template <std::size_t path_size_v, std::size_t reply_path_size_v = 0>
+struct static_route
+{
+    static_assert(reply_path_size_v <= 12, "reply path is at most 12 bytes long");
+    using layout_type = static_command_layout<path_size_v, (reply_path_size_v + 3) / 4 * 4>;
+
+    std::array<unsigned char, path_size_v> path;
+    std::array<unsigned char, reply_path_size_v> reply_path;
+
+    static constexpr layout_type layout() { return {}; }
+};
+
+struct route
+{
+    using layout_type = command_layout;
+
+    const unsigned char* path = nullptr;
+    std::size_t path_size = 0;
+    const unsigned char* reply_path = nullptr;
+    std::size_t reply_path_size = 0;
+
+    constexpr layout_type layout() const { return { path_size, (reply_path_size + 3) / 4 * 4 }; }
+};
+
+
+namespace details
+{
+    template <typename T, typename = void>
+    struct is_byte_range : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct is_byte_range<T,
+        std::void_t<decltype(std::data(std::declval<T&>())),
+            decltype(std::size(std::declval<T&>()))>>
+            : std::is_same<std::remove_pointer_t<decltype(std::data(std::declval<T&>()))>,
+                  unsigned char>
+    {
+    };
+
+    template <typename T>
+    static inline constexpr bool is_byte_range_v = is_byte_range<std::remove_reference_t<T>>::value;
+
+    template <typename T>
+    struct is_route : std::false_type
+    {
+    };
+    template <std::size_t path_size_v, std::size_t reply_path_size_v>
+    struct is_route<static_route<path_size_v, reply_path_size_v>> : std::true_type
+    {
+    };
+    template <>
+    struct is_route<route> : std::true_type
+    {
+    };
+    template <typename T>
+    static inline constexpr bool is_route_v = is_route<std::decay_t<T>>::value;
+
+    template <std::size_t path_size_v, std::size_t reply_path_size_v>
+    inline constexpr std::size_t reply_path_size(
+        const static_route<path_size_v, reply_path_size_v>&)
+    {
+        return reply_path_size_v;
+    }
+    inline std::size_t reply_path_size(const route& route) { return route.reply_path_size; }
+
+    template <std::size_t size>
+    inline const unsigned char* bytes(const std::array<unsigned char, size>& bytes)
+    {
+        return std::data(bytes);
+    }
+    inline const unsigned char* bytes(const unsigned char* bytes) { return bytes; }
+
+    // packet_type is given without reply address length, it is derived from the route.
+    // Every field but the header CRC.
+    template <typename route_t>
+    inline void encode_command_fields(const route_t& route, unsigned char packet_type,
+        unsigned char destination_logical_address, unsigned char destination_key,
+        unsigned char source_logical_address, unsigned char extended_address, uint32_t address,
+        uint16_t transaction_id, uint32_t data_length, unsigned char* buffer)
+    {
+        const auto layout = route.layout();
+        const command_view view { buffer, layout };
+        if (layout.path_size())
+            std::memcpy(buffer, bytes(route.path), layout.path_size());
+        view.destination_logical_address() = destination_logical_address;
+        view.protocol_identifier() = static_cast<unsigned char>(protocol_id_t::SPW_PROTO_ID_RMAP);
+        view.packet_type()
+            = packet_type | static_cast<unsigned char>(layout.reply_address_size() / 4);
+        view.destination_key() = destination_key;
+        if (layout.reply_address_size())
+        {
+            const std::size_t padding = layout.reply_address_size() - reply_path_size(route);
+            std::memset(view.reply_address(), 0, padding);
+            std::memcpy(
+                view.reply_address() + padding, bytes(route.reply_path), reply_path_size(route));
+        }
+        view.source_logical_address() = source_logical_address;
+        view.transaction_id() = transaction_id;
+        view.extended_address() = extended_address;
+        view.address() = address;
+        view.data_length() = data_length;
+    }
+
+    template <typename route_t>
+    inline void encode_command_header(const route_t& route, unsigned char packet_type,
+        unsigned char destination_logical_address, unsigned char destination_key,
+        unsigned char source_logical_address, unsigned char extended_address, uint32_t address,
+        uint16_t transaction_id, uint32_t data_length, unsigned char* buffer)
+    {
+        encode_command_fields(route, packet_type, destination_logical_address, destination_key,
+            source_logical_address, extended_address, address, transaction_id, data_length,
+            buffer);
+        const auto layout = route.layout();
+        const command_view view { buffer, layout };
+        view.header_crc() = spacewire::crc(
+            view.header(), layout.header_size() - layout.path_size() - 1);
+        // writes and read-modify-writes carry data
+        instrumentation::packet_built(
+            layout.header_size() + ((packet_type & 0b00110000) ? data_length + 1 : 0));
+    }
+
+    inline void encode_read_request(unsigned char destination_logical_address,
+        unsigned char destination_key, unsigned char source_logical_address, uint32_t read_address,
+        uint16_t transaction_id, uint32_t data_length, unsigned char* buffer)
+    {
+        encode_command_header(static_route<0> {}, read_packet_type(), destination_logical_address,
+            destination_key, source_logical_address, 0, read_address, transaction_id,
+            data_length, buffer);
+    }
+
+    inline void encode_write_request_header(unsigned char destination_logical_address,
+        unsigned char destination_key, unsigned char source_logical_address,
+        uint32_t write_address, uint16_t transaction_id, uint32_t data_length,
+        unsigned char* buffer)
+    {
+        encode_command_header(static_route<0> {}, write_packet_type(), destination_logical_address,
+            destination_key, source_logical_address, 0, write_address, transaction_id,
+            data_length, buffer);
+    }
+
+    // command_packet_type is the packet type of the command, the reply echoes its options
+    inline void encode_reply_header(unsigned char initiator_logical_address,
+        unsigned char command_packet_type, status_t status, unsigned char target_logical_address,
+        uint16_t transaction_id, unsigned char* buffer)
+    {
+        spacewire::fields::destination_logical_address(buffer) = initiator_logical_address;
+        spacewire::fields::protocol_identifier(buffer) = protocol_id_t::SPW_PROTO_ID_RMAP;
+        fields::packet_type(buffer) = command_packet_type & 0b00111111;
+        fields::status(buffer) = static_cast<unsigned char>(status);
+        fields::source_logical_address(buffer) = target_logical_address;
+        fields::transaction_idetifier(buffer) = transaction_id;
+    }
+
+    inline void encode_read_reply_header(unsigned char initiator_logical_address,
+        unsigned char command_packet_type, status_t status, unsigned char target_logical_address,
+        uint16_t transaction_id, uint32_t data_length, unsigned char* buffer)
+    {
+        encode_reply_header(initiator_logical_address, command_packet_type, status,
+            target_logical_address, transaction_id, buffer);
+        buffer[7] = 0;
+        fields::data_length<rmap_read_response_tag>(buffer) = data_length;
+        fields::header_crc<rmap_read_response_tag>(buffer)
+            = spacewire::crc(buffer, fields::header_crc_offset<rmap_read_response_tag>());
+        instrumentation::packet_built(read_reply_buffer_size(data_length));
+    }
 
+    inline void encode_write_request(unsigned char destination_logical_address,
+        unsigned char destination_key, unsigned char source_logical_address,
+        uint32_t write_address, uint16_t transaction_id, const unsigned char* data,
+        uint32_t data_length, unsigned char* buffer)
+    {
+        encode_write_request_header(destination_logical_address, destination_key,
+            source_logical_address, write_address, transaction_id, data_length, buffer);
+        std::memcpy(fields::data<rmap_write_cmd_tag>(buffer), data, data_length);
+        fields::data_crc<rmap_write_cmd_tag>(buffer)
+            = spacewire::crc(fields::data<rmap_write_cmd_tag>(buffer), data_length);
+    }
+}
 
 inline unsigned char* build_read_request(unsigned char destination_logical_address,
     unsigned char destination_key, unsigned char source_logical_address, uint32_t read_address,
@@ -246,17 +649,8 @@ inline unsigned char* build_read_request(unsigned char destination_logical_addre
     assert(data_length < (1 << 24));
     if (buffer == nullptr)
         buffer = new unsigned char[read_request_buffer_size()]();
-    spacewire::fields::destination_logical_address(buffer) = destination_logical_address;
-    spacewire::fields::protocol_identifier(buffer) = protocol_id_t::SPW_PROTO_ID_RMAP;
-    fields::packet_type(buffer) = 0b01001100;
-    fields::destination_key(buffer) = destination_key;
-    fields::source_logical_address(buffer) = source_logical_address;
-    fields::transaction_idetifier(buffer) = transaction_id;
-    fields::extended_read_address(buffer) = 0;
-    fields::address(buffer) = read_address;
-    fields::data_length<rmap_read_cmd_tag>(buffer) = data_length;
-    fields::header_crc<rmap_read_cmd_tag>(buffer)
-        = spacewire::crc(buffer, fields::header_crc_offset<rmap_read_cmd_tag>());
+    details::encode_read_request(destination_logical_address, destination_key,
+        source_logical_address, read_address, transaction_id, data_length, buffer);
     return buffer;
 }
 
@@ -268,23 +662,304 @@ inline unsigned char* build_write_request(unsigned char destination_logical_addr
     assert(data_length < (1 << 24));
     if (buffer == nullptr)
         buffer = new unsigned char[write_request_buffer_size(data_length)]();
-    spacewire::fields::destination_logical_address(buffer) = destination_logical_address;
-    spacewire::fields::protocol_identifier(buffer) = protocol_id_t::SPW_PROTO_ID_RMAP;
-    fields::packet_type(buffer) = 0b01101100;
-    fields::destination_key(buffer) = destination_key;
-    fields::source_logical_address(buffer) = source_logical_address;
-    fields::transaction_idetifier(buffer) = transaction_id;
-    fields::extended_read_address(buffer) = 0;
-    fields::address(buffer) = write_address;
-    fields::data_length<rmap_write_cmd_tag>(buffer) = data_length;
-    fields::header_crc<rmap_write_cmd_tag>(buffer)
-        = spacewire::crc(buffer, fields::header_crc_offset<rmap_write_cmd_tag>());
-    std::memcpy(fields::data<rmap_write_cmd_tag>(buffer), data, data_length);
-    fields::data_crc<rmap_write_cmd_tag>(buffer)
-        = spacewire::crc(fields::data<rmap_write_cmd_tag>(buffer), data_length);
+    details::encode_write_request(destination_logical_address, destination_key,
+        source_logical_address, write_address, transaction_id, data, data_length, buffer);
     return buffer;
 }
 
+/*
+ * Reply builders, buffer must be at least write_reply_size() or
+ * read_reply_buffer_size(data_length) bytes long. They return the reply size.
+ * Read-modify-write replies are built as read replies, they echo the command packet type.
+ */
+inline std::size_t build_write_reply(unsigned char initiator_logical_address,
+    unsigned char command_packet_type, status_t status, unsigned char target_logical_address,
+    uint16_t transaction_id, unsigned char* buffer)
+{
+    details::encode_reply_header(initiator_logical_address, command_packet_type, status,
+        target_logical_address, transaction_id, buffer);
+    fields::header_crc<rmap_write_response_tag>(buffer)
+        = spacewire::crc(buffer, fields::header_crc_offset<rmap_write_response_tag>());
+    instrumentation::packet_built(write_reply_size());
+    return write_reply_size();
+}
+
+inline std::size_t build_read_reply(unsigned char initiator_logical_address,
+    unsigned char command_packet_type, status_t status, unsigned char target_logical_address,
+    uint16_t transaction_id, const unsigned char* data, uint32_t data_length,
+    unsigned char* buffer)
+{
+    assert(data_length < (1 << 24));
+    details::encode_read_reply_header(initiator_logical_address, command_packet_type, status,
+        target_logical_address, transaction_id, data_length, buffer);
+    if (data_length)
+        std::memcpy(fields::data<rmap_read_response_tag>(buffer), data, data_length);
+    fields::data_crc<rmap_read_response_tag>(buffer) = spacewire::crc(data, data_length);
+    return read_reply_buffer_size(data_length);
+}
+
+/*
+ * Non allocating builders, the packet is written into the caller provided buffer.
+ * They return the packet size or std::nullopt when data_length does not fit in 24 bits or when
+ * the buffer is too small, in which case the buffer is left untouched.
+ */
+inline std::optional<std::size_t> build_read_request(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint32_t read_address,
+    uint16_t transaction_id, uint32_t data_length, unsigned char* buffer, std::size_t buffer_size)
+{
+    if (data_length >= (1 << 24) || buffer_size < read_request_buffer_size())
+        return std::nullopt;
+    details::encode_read_request(destination_logical_address, destination_key,
+        source_logical_address, read_address, transaction_id, data_length, buffer);
+    return read_request_buffer_size();
+}
+
+inline std::optional<std::size_t> build_write_request(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint32_t write_address,
+    uint16_t transaction_id, const unsigned char* data, uint32_t data_length,
+    unsigned char* buffer, std::size_t buffer_size)
+{
+    if (data_length >= (1 << 24) || buffer_size < write_request_buffer_size(data_length))
+        return std::nullopt;
+    details::encode_write_request(destination_logical_address, destination_key,
+        source_logical_address, write_address, transaction_id, data, data_length, buffer);
+    return write_request_buffer_size(data_length);
+}
+
+template <typename range_t, typename = std::enable_if_t<details::is_byte_range_v<range_t>>>
+inline std::optional<std::size_t> build_read_request(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint32_t read_address,
+    uint16_t transaction_id, uint32_t data_length, range_t&& buffer)
+{
+    return build_read_request(destination_logical_address, destination_key,
+        source_logical_address, read_address, transaction_id, data_length, std::data(buffer),
+        std::size(buffer));
+}
+
+template <typename range_t, typename = std::enable_if_t<details::is_byte_range_v<range_t>>>
+inline std::optional<std::size_t> build_write_request(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint32_t write_address,
+    uint16_t transaction_id, const unsigned char* data, uint32_t data_length, range_t&& buffer)
+{
+    return build_write_request(destination_logical_address, destination_key,
+        source_logical_address, write_address, transaction_id, data, data_length,
+        std::data(buffer), std::size(buffer));
+}
+
+/*
+ * Routed builders, the packet starts with the route path address bytes and carries its reply
+ * address. Same return values as the builders above.
+ */
+template <typename route_t, typename = std::enable_if_t<details::is_route_v<route_t>>>
+inline std::optional<std::size_t> build_read_request(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint32_t read_address, uint16_t transaction_id,
+    uint32_t data_length, unsigned char* buffer, std::size_t buffer_size)
+{
+    const std::size_t size = read_request_buffer_size(route.layout());
+    if (data_length >= (1 << 24) || buffer_size < size)
+        return std::nullopt;
+    details::encode_command_header(route, read_packet_type(), destination_logical_address,
+        destination_key, source_logical_address, 0, read_address, transaction_id, data_length,
+        buffer);
+    return size;
+}
+
+template <typename route_t, typename = std::enable_if_t<details::is_route_v<route_t>>>
+inline std::optional<std::size_t> build_write_request(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint32_t write_address, uint16_t transaction_id,
+    const unsigned char* data, uint32_t data_length, unsigned char* buffer,
+    std::size_t buffer_size)
+{
+    const auto layout = route.layout();
+    if (data_length >= (1 << 24) || buffer_size < write_request_buffer_size(layout, data_length))
+        return std::nullopt;
+    details::encode_command_header(route, write_packet_type(), destination_logical_address,
+        destination_key, source_logical_address, 0, write_address, transaction_id, data_length,
+        buffer);
+    const command_view view { buffer, layout };
+    std::memcpy(view.data(), data, data_length);
+    view.data_crc() = spacewire::crc(data, data_length);
+    return write_request_buffer_size(layout, data_length);
+}
+
+template <typename route_t, typename range_t,
+    typename = std::enable_if_t<details::is_route_v<route_t> && details::is_byte_range_v<range_t>>>
+inline std::optional<std::size_t> build_read_request(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint32_t read_address, uint16_t transaction_id,
+    uint32_t data_length, range_t&& buffer)
+{
+    return build_read_request(route, destination_logical_address, destination_key,
+        source_logical_address, read_address, transaction_id, data_length, std::data(buffer),
+        std::size(buffer));
+}
+
+template <typename route_t, typename range_t,
+    typename = std::enable_if_t<details::is_route_v<route_t> && details::is_byte_range_v<range_t>>>
+inline std::optional<std::size_t> build_write_request(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint32_t write_address, uint16_t transaction_id,
+    const unsigned char* data, uint32_t data_length, range_t&& buffer)
+{
+    return build_write_request(route, destination_logical_address, destination_key,
+        source_logical_address, write_address, transaction_id, data, data_length,
+        std::data(buffer), std::size(buffer));
+}
+
+/*
+ * Builders for every command option, address is 40 bits wide, its upper byte being the
+ * extended address. Same return values as the builders above, std::nullopt is also returned
+ * when address does not fit in 40 bits.
+ */
+template <unsigned char command_options = options::increment, typename route_t,
+    typename = std::enable_if_t<details::is_route_v<route_t>>>
+inline std::optional<std::size_t> build_read_command(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint64_t read_address, uint16_t transaction_id,
+    uint32_t data_length, unsigned char* buffer, std::size_t buffer_size)
+{
+    constexpr unsigned char packet_type = read_packet_type<command_options>();
+    const std::size_t size = read_request_buffer_size(route.layout());
+    if (read_address >> 40 || data_length >= (1 << 24) || buffer_size < size)
+        return std::nullopt;
+    details::encode_command_header(route, packet_type, destination_logical_address,
+        destination_key, source_logical_address, static_cast<unsigned char>(read_address >> 32),
+        static_cast<uint32_t>(read_address), transaction_id, data_length, buffer);
+    return size;
+}
+
+template <unsigned char command_options = options::increment>
+inline std::optional<std::size_t> build_read_command(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint64_t read_address,
+    uint16_t transaction_id, uint32_t data_length, unsigned char* buffer, std::size_t buffer_size)
+{
+    return build_read_command<command_options>(static_route<0> {}, destination_logical_address,
+        destination_key, source_logical_address, read_address, transaction_id, data_length,
+        buffer, buffer_size);
+}
+
+template <unsigned char command_options = options::acknowledge | options::increment,
+    typename route_t, typename = std::enable_if_t<details::is_route_v<route_t>>>
+inline std::optional<std::size_t> build_write_command(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint64_t write_address, uint16_t transaction_id,
+    const unsigned char* data, uint32_t data_length, unsigned char* buffer,
+    std::size_t buffer_size)
+{
+    constexpr unsigned char packet_type = write_packet_type<command_options>();
+    const auto layout = route.layout();
+    if (write_address >> 40 || data_length >= (1 << 24)
+        || buffer_size < write_request_buffer_size(layout, data_length))
+        return std::nullopt;
+    details::encode_command_header(route, packet_type, destination_logical_address,
+        destination_key, source_logical_address, static_cast<unsigned char>(write_address >> 32),
+        static_cast<uint32_t>(write_address), transaction_id, data_length, buffer);
+    const command_view view { buffer, layout };
+    if (data_length)
+        std::memcpy(view.data(), data, data_length);
+    view.data_crc() = spacewire::crc(data, data_length);
+    return write_request_buffer_size(layout, data_length);
+}
+
+template <unsigned char command_options = options::acknowledge | options::increment>
+inline std::optional<std::size_t> build_write_command(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint64_t write_address,
+    uint16_t transaction_id, const unsigned char* data, uint32_t data_length,
+    unsigned char* buffer, std::size_t buffer_size)
+{
+    return build_write_command<command_options>(static_route<0> {}, destination_logical_address,
+        destination_key, source_logical_address, write_address, transaction_id, data,
+        data_length, buffer, buffer_size);
+}
+
+/*
+ * Read-modify-write of a data_size bytes word (at most 4): the target writes
+ * (data & mask) | (old & ~mask) and replies with the old value.
+ */
+template <typename route_t, typename = std::enable_if_t<details::is_route_v<route_t>>>
+inline std::optional<std::size_t> build_rmw_command(const route_t& route,
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint64_t address, uint16_t transaction_id,
+    const unsigned char* data, const unsigned char* mask, uint32_t data_size,
+    unsigned char* buffer, std::size_t buffer_size)
+{
+    const auto layout = route.layout();
+    if (address >> 40 || data_size > 4
+        || buffer_size < write_request_buffer_size(layout, 2 * data_size))
+        return std::nullopt;
+    details::encode_command_header(route, rmw_packet_type(), destination_logical_address,
+        destination_key, source_logical_address, static_cast<unsigned char>(address >> 32),
+        static_cast<uint32_t>(address), transaction_id, 2 * data_size, buffer);
+    const command_view view { buffer, layout };
+    if (data_size)
+    {
+        std::memcpy(view.data(), data, data_size);
+        std::memcpy(view.data() + data_size, mask, data_size);
+    }
+    view.data_crc() = spacewire::crc(view.data(), 2 * data_size);
+    return write_request_buffer_size(layout, 2 * data_size);
+}
+
+inline std::optional<std::size_t> build_rmw_command(unsigned char destination_logical_address,
+    unsigned char destination_key, unsigned char source_logical_address, uint64_t address,
+    uint16_t transaction_id, const unsigned char* data, const unsigned char* mask,
+    uint32_t data_size, unsigned char* buffer, std::size_t buffer_size)
+{
+    return build_rmw_command(static_route<0> {}, destination_logical_address, destination_key,
+        source_logical_address, address, transaction_id, data, mask, data_size, buffer,
+        buffer_size);
+}
+
+/*
+ * Zero-copy write request, the packet is the concatenation of header, payload and trailer
+ * (data CRC). The payload is referenced in place and must outlive the segments, it is only read
+ * once to compute the data CRC.
+ */
+struct write_request_segments
+{
+    std::array<unsigned char, request_header_size()> header;
+    const unsigned char* payload;
+    std::size_t payload_size;
+    unsigned char trailer;
+
+    std::size_t size() const { return std::size(header) + payload_size + 1; }
+
+    void copy_to(unsigned char* buffer) const
+    {
+        std::memcpy(buffer, std::data(header), std::size(header));
+        std::memcpy(buffer + std::size(header), payload, payload_size);
+        buffer[std::size(header) + payload_size] = trailer;
+    }
+
+#if __has_include(<sys/uio.h>)
+    // The returned iovecs point into this object, they are invalidated if it is moved or copied
+    std::array<iovec, 3> iovecs() const
+    {
+        return { iovec { const_cast<unsigned char*>(std::data(header)), std::size(header) },
+            iovec { const_cast<unsigned char*>(payload), payload_size },
+            iovec { const_cast<unsigned char*>(&trailer), 1 } };
+    }
+#endif
+};
+
+inline write_request_segments build_write_request_segments(
+    unsigned char destination_logical_address, unsigned char destination_key,
+    unsigned char source_logical_address, uint32_t write_address, uint16_t transaction_id,
+    const unsigned char* data, uint32_t data_length)
+{
+    assert(data_length < (1 << 24));
+    write_request_segments segments;
+    details::encode_write_request_header(destination_logical_address, destination_key,
+        source_logical_address, write_address, transaction_id, data_length,
+        std::data(segments.header));
+    segments.payload = data;
+    segments.payload_size = data_length;
+    segments.trailer = spacewire::crc(data, data_length);
+    return segments;
+}
+
 template <typename packet_type>
 inline bool header_crc_valid(const unsigned char* packet)
 {
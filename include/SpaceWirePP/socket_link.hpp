@@ -0,0 +1,255 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "link.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace spacewire
+{
+
+/*
+ * Link over a connected packet preserving socket (SOCK_SEQPACKET or SOCK_DGRAM), one SpaceWire
+ * packet per message. The link owns the file descriptor.
+ */
+class socket_link : public link
+{
+public:
+    static constexpr std::size_t max_gather = 16;
+    static constexpr std::size_t max_batch = 64;
+
+    explicit socket_link(int fd) : m_fd { fd } { }
+    ~socket_link() override { close(); }
+
+    socket_link(socket_link&& other) noexcept : m_fd { std::exchange(other.m_fd, -1) }
+    {
+    }
+    socket_link& operator=(socket_link&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_fd = std::exchange(other.m_fd, -1);
+        }
+        return *this;
+    }
+
+    bool is_open() const { return m_fd >= 0; }
+    int fd() const { return m_fd; }
+
+    using link::send;
+    bool send(const const_buffer* buffers, std::size_t count) override
+    {
+        if (m_fd < 0 || count > max_gather)
+            return false;
+        std::array<iovec, max_gather> iov;
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            iov[i] = iovec { const_cast<unsigned char*>(buffers[i].data), buffers[i].size };
+            size += buffers[i].size;
+        }
+        msghdr message {};
+        message.msg_iov = iov.data();
+        message.msg_iovlen = count;
+        ssize_t sent;
+        do
+        {
+            sent = ::sendmsg(m_fd, &message, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        return sent == static_cast<ssize_t>(size);
+    }
+
+#ifdef __linux__
+    /*
+     * One sendmmsg() call per max_batch packets.
+     */
+    std::size_t send_packets(const const_buffer* packets, std::size_t count) override
+    {
+        if (m_fd < 0)
+            return 0;
+        std::array<iovec, max_batch> iov;
+        std::array<mmsghdr, max_batch> messages;
+        std::size_t sent = 0;
+        while (sent < count)
+        {
+            const std::size_t n = std::min(count - sent, max_batch);
+            for (std::size_t i = 0; i < n; i++)
+            {
+                iov[i] = iovec { const_cast<unsigned char*>(packets[sent + i].data),
+                    packets[sent + i].size };
+                messages[i] = mmsghdr {};
+                messages[i].msg_hdr.msg_iov = &iov[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int result;
+            do
+            {
+                result = ::sendmmsg(m_fd, messages.data(), static_cast<unsigned>(n), MSG_NOSIGNAL);
+            } while (result < 0 && errno == EINTR);
+            if (result <= 0)
+                break;
+            sent += static_cast<std::size_t>(result);
+        }
+        return sent;
+    }
+#endif
+
+    std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        iovec iov { buffer, capacity };
+        return receive_message(&iov, 1, 0, timeout);
+    }
+
+    bool can_peek() const override { return true; }
+
+    std::optional<std::size_t> peek(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        iovec iov { buffer, capacity };
+        return receive_message(&iov, 1, MSG_PEEK, timeout);
+    }
+
+    /*
+     * One recvmsg() call, at most max_gather buffers.
+     */
+    std::optional<std::size_t> receive_scatter(const mutable_buffer* buffers, std::size_t count,
+        std::chrono::milliseconds timeout) override
+    {
+        if (count > max_gather)
+            return std::nullopt;
+        std::array<iovec, max_gather> iov;
+        for (std::size_t i = 0; i < count; i++)
+            iov[i] = iovec { buffers[i].data, buffers[i].size };
+        return receive_message(iov.data(), count, 0, timeout);
+    }
+
+#ifdef __linux__
+    /*
+     * One recvmmsg() call for up to max_batch packets once the first one is there.
+     */
+    std::optional<std::size_t> receive_packets(const mutable_buffer* buffers,
+        std::size_t* sizes, std::size_t count, std::chrono::milliseconds timeout) override
+    {
+        if (m_fd < 0)
+            return std::nullopt;
+        if (count == 0)
+            return 0;
+        pollfd pfd { m_fd, POLLIN, 0 };
+        const int ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+            return 0;
+        if (ready < 0)
+            return std::nullopt;
+        const std::size_t n = std::min(count, max_batch);
+        std::array<iovec, max_batch> iov;
+        std::array<mmsghdr, max_batch> messages;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            iov[i] = iovec { buffers[i].data, buffers[i].size };
+            messages[i] = mmsghdr {};
+            messages[i].msg_hdr.msg_iov = &iov[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        int result;
+        do
+        {
+            result = ::recvmmsg(
+                m_fd, messages.data(), static_cast<unsigned>(n), MSG_DONTWAIT | MSG_TRUNC, nullptr);
+        } while (result < 0 && errno == EINTR);
+        if (result < 0)
+            return transient(errno, pfd) ? std::optional<std::size_t> { 0 } : std::nullopt;
+        const bool hang_up = pfd.revents & (POLLHUP | POLLERR);
+        std::size_t received = 0;
+        for (; received < static_cast<std::size_t>(result); received++)
+        {
+            if (messages[received].msg_len == 0 && hang_up)
+                break;
+            sizes[received] = messages[received].msg_len;
+        }
+        if (received == 0 && hang_up)
+            return std::nullopt;
+        return received;
+    }
+#endif
+
+    /*
+     * Shuts both directions down, unlike close() it is safe to call while another thread is
+     * blocked in receive(), which then returns std::nullopt.
+     */
+    void shutdown()
+    {
+        if (m_fd >= 0)
+            ::shutdown(m_fd, SHUT_RDWR);
+    }
+
+    void close()
+    {
+        if (m_fd >= 0)
+            ::close(std::exchange(m_fd, -1));
+    }
+
+private:
+    std::optional<std::size_t> receive_message(
+        iovec* iov, std::size_t count, int flags, std::chrono::milliseconds timeout)
+    {
+        if (m_fd < 0)
+            return std::nullopt;
+        pollfd pfd { m_fd, POLLIN, 0 };
+        const int ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+            return 0;
+        if (ready < 0)
+            return std::nullopt;
+        msghdr message {};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        const ssize_t received = ::recvmsg(m_fd, &message, flags | MSG_TRUNC);
+        if (received < 0)
+            return transient(errno, pfd) ? std::optional<std::size_t> { 0 } : std::nullopt;
+        // with SOCK_SEQPACKET a zero length message means the peer closed the connection
+        if (received == 0 && (pfd.revents & (POLLHUP | POLLERR)))
+            return std::nullopt;
+        return static_cast<std::size_t>(received);
+    }
+
+    /*
+     * ECONNREFUSED reports an ICMP error from a previous datagram, the socket is still usable.
+     * A shut down datagram socket polls readable with POLLHUP but recv() fails with EAGAIN.
+     */
+    static bool transient(int error, const pollfd& pfd)
+    {
+        if (error == EAGAIN || error == EWOULDBLOCK)
+            return !(pfd.revents & POLLHUP);
+        return error == EINTR || error == ECONNREFUSED;
+    }
+
+    int m_fd;
+};
+
+}
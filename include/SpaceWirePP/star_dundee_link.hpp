@@ -0,0 +1,261 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "link.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <star-api.h>
+
+namespace spacewire
+{
+
+/*
+ * Link over a channel of a STAR-Dundee device through the STAR-System API, only available when
+ * the library is configured with the with_stardundee option.
+ *
+ * receive_depth receive operations of one packet each are kept submitted so the device never
+ * waits for the caller; lease() hands out the packet buffer of the completed operation itself
+ * and submits a new one. Sends wait for the transfer to complete, send_packets() submits all
+ * packets as a single transfer operation.
+ */
+class star_dundee_link : public link
+{
+public:
+    static constexpr std::size_t default_receive_depth = 16;
+    static constexpr int send_timeout_ms = 1000;
+
+    star_dundee_link() = default;
+    ~star_dundee_link() override { close(); }
+
+    star_dundee_link(star_dundee_link&& other) noexcept
+            : m_channel { std::exchange(other.m_channel, 0) }
+            , m_pending { std::move(other.m_pending) }
+            , m_receive_depth { other.m_receive_depth }
+    {
+    }
+    star_dundee_link& operator=(star_dundee_link&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_channel = std::exchange(other.m_channel, 0);
+            m_pending = std::move(other.m_pending);
+            m_receive_depth = other.m_receive_depth;
+        }
+        return *this;
+    }
+
+    /*
+     * Opens channel of the device_index-th device found, returns a closed link on failure.
+     */
+    static star_dundee_link open(unsigned int device_index, unsigned char channel,
+        std::size_t receive_depth = default_receive_depth)
+    {
+        star_dundee_link result;
+        U32 device_count = 0;
+        STAR_DEVICE_ID* devices = STAR_getDeviceList(&device_count);
+        if (devices == nullptr)
+            return result;
+        if (device_index < device_count)
+            result.m_channel = STAR_openChannelToLocalDevice(
+                devices[device_index], STAR_CHANNEL_DIRECTION_INOUT, channel, TRUE);
+        STAR_destroyDeviceList(devices);
+        result.m_receive_depth = std::max<std::size_t>(receive_depth, 1);
+        while (result.is_open() && std::size(result.m_pending) < result.m_receive_depth)
+        {
+            if (!result.submit_receive())
+                result.close();
+        }
+        return result;
+    }
+
+    bool is_open() const { return m_channel != 0; }
+
+    using link::send;
+    bool send(const const_buffer* buffers, std::size_t count) override
+    {
+        std::lock_guard<std::mutex> lock { m_send_mutex };
+        if (count == 1)
+            return transmit(buffers, 1) == 1;
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < count; i++)
+            size += buffers[i].size;
+        m_gather.resize(size);
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::memcpy(m_gather.data() + offset, buffers[i].data, buffers[i].size);
+            offset += buffers[i].size;
+        }
+        const const_buffer packet { m_gather.data(), size };
+        return transmit(&packet, 1) == 1;
+    }
+
+    std::size_t send_packets(const const_buffer* packets, std::size_t count) override
+    {
+        std::lock_guard<std::mutex> lock { m_send_mutex };
+        return transmit(packets, count);
+    }
+
+    std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        const auto operation = next_packet(timeout);
+        if (!operation)
+            return std::nullopt;
+        if (*operation == nullptr)
+            return 0;
+        U32 size = 0;
+        const U8* data = packet_data(*operation, size);
+        std::memcpy(buffer, data, std::min<std::size_t>(capacity, size));
+        STAR_disposeTransferOperation(*operation);
+        return size;
+    }
+
+    std::optional<receive_lease> lease(std::chrono::milliseconds timeout) override
+    {
+        const auto operation = next_packet(timeout);
+        if (!operation)
+            return std::nullopt;
+        if (*operation == nullptr)
+            return receive_lease {};
+        U32 size = 0;
+        const U8* data = packet_data(*operation, size);
+        return receive_lease { data, size, this, reinterpret_cast<std::uintptr_t>(*operation) };
+    }
+
+    /*
+     * Cancels the pending receive operations and closes the channel, must not be called while
+     * another thread is in receive().
+     */
+    void close()
+    {
+        for (auto operation : m_pending)
+        {
+            STAR_cancelTransferOperation(operation);
+            STAR_disposeTransferOperation(operation);
+        }
+        m_pending.clear();
+        if (m_channel != 0)
+            STAR_closeChannel(std::exchange(m_channel, 0));
+    }
+
+private:
+    void release(std::uintptr_t token) override
+    {
+        STAR_disposeTransferOperation(reinterpret_cast<STAR_TRANSFER_OPERATION*>(token));
+    }
+
+    bool submit_receive()
+    {
+        auto operation = STAR_createRxOperation(1, STAR_RECEIVE_PACKETS);
+        if (operation == nullptr)
+            return false;
+        if (!STAR_submitTransferOperation(m_channel, operation))
+        {
+            STAR_disposeTransferOperation(operation);
+            return false;
+        }
+        m_pending.push_back(operation);
+        return true;
+    }
+
+    /*
+     * Completed receive operation holding one packet, nullptr on timeout and std::nullopt when
+     * the channel failed. The caller owns the returned operation.
+     */
+    std::optional<STAR_TRANSFER_OPERATION*> next_packet(std::chrono::milliseconds timeout)
+    {
+        if (m_pending.empty())
+            return std::nullopt;
+        auto operation = m_pending.front();
+        const auto status
+            = STAR_waitOnTransferOperationCompletion(operation, static_cast<int>(timeout.count()));
+        if (status == STAR_TRANSFER_STATUS_STARTED || status == STAR_TRANSFER_STATUS_NOT_STARTED)
+            return nullptr;
+        m_pending.pop_front();
+        if (status != STAR_TRANSFER_STATUS_COMPLETE || !submit_receive())
+        {
+            STAR_disposeTransferOperation(operation);
+            return std::nullopt;
+        }
+        return operation;
+    }
+
+    static const U8* packet_data(STAR_TRANSFER_OPERATION* operation, U32& size)
+    {
+        static const U8 empty = 0;
+        size = 0;
+        auto item = STAR_getTransferItem(operation, 0);
+        if (item == nullptr || item->itemType != STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
+            return &empty;
+        const U8* data
+            = STAR_getPacketData(static_cast<STAR_SPACEWIRE_PACKET*>(item->item), &size);
+        return data ? data : &empty;
+    }
+
+    // called with m_send_mutex held
+    std::size_t transmit(const const_buffer* packets, std::size_t count)
+    {
+        if (m_channel == 0 || count == 0)
+            return 0;
+        m_items.clear();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto item = STAR_createPacket(nullptr, const_cast<U8*>(packets[i].data),
+                static_cast<U32>(packets[i].size), STAR_EOP_TYPE_EOP);
+            if (item == nullptr)
+                break;
+            m_items.push_back(item);
+        }
+        std::size_t sent = 0;
+        if (auto operation
+            = STAR_createTxOperation(m_items.data(), static_cast<U32>(std::size(m_items))))
+        {
+            if (STAR_submitTransferOperation(m_channel, operation)
+                && STAR_waitOnTransferOperationCompletion(operation, send_timeout_ms)
+                    == STAR_TRANSFER_STATUS_COMPLETE)
+                sent = std::size(m_items);
+            else
+                STAR_cancelTransferOperation(operation);
+            STAR_disposeTransferOperation(operation);
+        }
+        for (auto item : m_items)
+            STAR_destroyStreamItem(item);
+        return sent;
+    }
+
+    STAR_CHANNEL_ID m_channel = 0;
+    std::deque<STAR_TRANSFER_OPERATION*> m_pending;
+    std::size_t m_receive_depth = default_receive_depth;
+    std::mutex m_send_mutex;
+    std::vector<unsigned char> m_gather;
+    std::vector<STAR_STREAM_ITEM*> m_items;
+};
+
+}
@@ -0,0 +1,318 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "link.hpp"
+#include "mapped_memory.hpp"
+#include "packet_view.hpp"
+#include "rmap.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace spacewire::rmap
+{
+
+/*
+ * Software RMAP target executing commands against a map of memory regions and callbacks.
+ *
+ * Addresses are 40 bits wide: extended address << 32 | address. Regions must not overlap and
+ * a command must fit in a single region, otherwise it is rejected as not authorised.
+ * Commands with a header CRC error or an unknown packet type are discarded without reply.
+ * Non verified writes are applied even when their data CRC is wrong, like hardware targets
+ * streaming data to memory before the CRC is received; the error is still reported.
+ * Read-modify-writes need a readable and writable region and call both callbacks.
+ */
+class target
+{
+public:
+    using read_callback_t = std::function<status_t(
+        uint64_t offset, unsigned char* data, std::size_t size, bool increment)>;
+    using write_callback_t = std::function<status_t(
+        uint64_t offset, const unsigned char* data, std::size_t size, bool increment)>;
+
+    explicit target(unsigned char logical_address = 0xFE, unsigned char key = 0)
+            : m_logical_address { logical_address }, m_key { key }
+    {
+    }
+
+    unsigned char logical_address() const { return m_logical_address; }
+    unsigned char key() const { return m_key; }
+
+    void map_memory(uint64_t address, unsigned char* memory, std::size_t size, bool writable = true)
+    {
+        insert(region { address, size, memory, writable, {}, {} });
+    }
+
+    /*
+     * Either callback can be empty, the corresponding accesses are then not authorised.
+     */
+    void map_callbacks(uint64_t address, std::size_t size, read_callback_t read_callback,
+        write_callback_t write_callback)
+    {
+        const bool writable = static_cast<bool>(write_callback);
+        insert(region { address, size, nullptr, writable, std::move(read_callback),
+            std::move(write_callback) });
+    }
+
+    /*
+     * Executes the command and writes its reply into reply.
+     * Returns the reply size, 0 when no reply is due (no ack requested or discarded command).
+     */
+    std::size_t handle(const packet_view& command, unsigned char* reply, std::size_t capacity)
+    {
+        if (!command.is_command() || !command.header_crc_valid())
+            return 0;
+        const std::size_t path_size = reply_path(command, reply, capacity);
+        if (path_size == capacity)
+            return 0;
+        status_t status = check(command);
+        const uint64_t address = command.full_address();
+        if (command.kind() == packet_kind::write_command)
+        {
+            if (status == status_t::success
+                || (status == status_t::invalid_data_crc && !command.verify()))
+            {
+                const status_t write_status = write(command, address);
+                if (status == status_t::success)
+                    status = write_status;
+            }
+            if (!command.acknowledge())
+                return 0;
+            if (capacity - path_size < write_reply_size())
+                return 0;
+            return path_size
+                + build_write_reply(command.source_logical_address(), command.packet_type(),
+                    status, m_logical_address, command.transaction_id(), reply + path_size);
+        }
+        unsigned char* header = reply + path_size;
+        if (command.kind() == packet_kind::rmw_command)
+        {
+            if (status == status_t::success
+                && (command.data_length() % 2 != 0 || command.data_length() > 8))
+                status = status_t::rmw_data_length_error;
+            unsigned char old[4] {};
+            if (status == status_t::success)
+                status = read_modify_write(command, address, old);
+            const std::size_t length = status == status_t::success ? command.data_length() / 2 : 0;
+            if (capacity - path_size < rmw_reply_buffer_size(length))
+                return 0;
+            return path_size
+                + build_read_reply(command.source_logical_address(), command.packet_type(),
+                    status, m_logical_address, command.transaction_id(), old,
+                    static_cast<uint32_t>(length), header);
+        }
+        // read
+        std::size_t length = command.data_length();
+        if (status == status_t::success
+            && capacity - path_size < read_reply_buffer_size(length))
+            status = status_t::general_error;
+        if (status == status_t::success)
+            status = read(command, address, header + read_reply_header_size());
+        if (status != status_t::success)
+            length = 0;
+        if (capacity - path_size < read_reply_buffer_size(length))
+            return 0;
+        details::encode_read_reply_header(command.source_logical_address(),
+            command.packet_type(), status, m_logical_address, command.transaction_id(),
+            static_cast<uint32_t>(length), header);
+        header[read_reply_header_size() + length]
+            = spacewire::crc(header + read_reply_header_size(), length);
+        return path_size + read_reply_buffer_size(length);
+    }
+
+    std::size_t handle(
+        const unsigned char* command, std::size_t size, unsigned char* reply, std::size_t capacity)
+    {
+        return handle(packet_view { command, size }, reply, capacity);
+    }
+
+    /*
+     * Executes commands received from link and sends back their replies until the link is
+     * closed or stop is set. Returns the number of commands received.
+     */
+    std::size_t serve(spacewire::link& link, const std::atomic<bool>* stop = nullptr,
+        std::size_t max_packet_size = (1 << 24) + 32)
+    {
+        std::vector<unsigned char> command(max_packet_size);
+        std::vector<unsigned char> reply(max_packet_size);
+        std::size_t count = 0;
+        while (!stop || !stop->load(std::memory_order_relaxed))
+        {
+            const auto size = link.receive(
+                command.data(), std::size(command), std::chrono::milliseconds { 50 });
+            if (!size)
+                break;
+            if (*size == 0 || *size > std::size(command))
+                continue;
+            count++;
+            if (const auto reply_size
+                = handle(command.data(), *size, reply.data(), std::size(reply));
+                reply_size)
+                link.send(reply.data(), reply_size);
+        }
+        return count;
+    }
+
+private:
+    struct region
+    {
+        uint64_t address;
+        std::size_t size;
+        unsigned char* memory;
+        bool writable;
+        read_callback_t read;
+        write_callback_t write;
+    };
+
+    void insert(region&& r)
+    {
+        auto position = std::upper_bound(std::begin(m_regions), std::end(m_regions), r.address,
+            [](uint64_t address, const region& other) { return address < other.address; });
+        m_regions.insert(position, std::move(r));
+    }
+
+    const region* find(uint64_t address, std::size_t size) const
+    {
+        auto position = std::upper_bound(std::cbegin(m_regions), std::cend(m_regions), address,
+            [](uint64_t address, const region& other) { return address < other.address; });
+        if (position == std::cbegin(m_regions))
+            return nullptr;
+        const region& r = *std::prev(position);
+        if (address - r.address + size > r.size)
+            return nullptr;
+        return &r;
+    }
+
+    // Copies the reply address with its leading zeros stripped, returns its size
+    static std::size_t reply_path(
+        const packet_view& command, unsigned char* reply, std::size_t capacity)
+    {
+        const unsigned char* path = command.reply_address();
+        std::size_t size = command.reply_address_size();
+        while (size && *path == 0)
+        {
+            path++;
+            size--;
+        }
+        if (size > capacity)
+            return capacity;
+        std::memcpy(reply, path, size);
+        return size;
+    }
+
+    status_t check(const packet_view& command) const
+    {
+        if (command.destination_logical_address() != m_logical_address)
+            return status_t::invalid_target_logical_address;
+        if (command.key() != m_key)
+            return status_t::invalid_key;
+        switch (command.error())
+        {
+            case packet_error::none:
+                return status_t::success;
+            case packet_error::early_eop:
+                return status_t::early_eop;
+            case packet_error::too_much_data:
+                return status_t::too_much_data;
+            case packet_error::data_crc:
+                return status_t::invalid_data_crc;
+            default:
+                return status_t::general_error;
+        }
+    }
+
+    // accessed range, a non incrementing access only touches one address
+    static std::size_t span(const packet_view& command)
+    {
+        return command.increment() ? command.data_length()
+                                   : std::min<std::size_t>(1, command.data_length());
+    }
+
+    status_t write(const packet_view& command, uint64_t address)
+    {
+        const region* r = find(address, span(command));
+        if (!r || !r->writable)
+            return status_t::not_authorised;
+        const uint64_t offset = address - r->address;
+        const std::size_t size = command.data_length();
+        if (!r->memory)
+            return r->write(offset, command.data(), size, command.increment());
+        if (size == 0)
+            return status_t::success;
+        if (command.increment())
+            std::memcpy(r->memory + offset, command.data(), size);
+        else
+            r->memory[offset] = command.data()[size - 1];
+        return status_t::success;
+    }
+
+    status_t read(const packet_view& command, uint64_t address, unsigned char* data) const
+    {
+        const region* r = find(address, span(command));
+        if (!r || (!r->memory && !r->read))
+            return status_t::not_authorised;
+        const uint64_t offset = address - r->address;
+        const std::size_t size = command.data_length();
+        if (!r->memory)
+            return r->read(offset, data, size, command.increment());
+        if (size == 0)
+            return status_t::success;
+        if (command.increment())
+            std::memcpy(data, r->memory + offset, size);
+        else
+            std::memset(data, r->memory[offset], size);
+        return status_t::success;
+    }
+
+    // writes (data & mask) | (old & ~mask), old is the previous value returned to the initiator
+    status_t read_modify_write(const packet_view& command, uint64_t address, unsigned char* old)
+    {
+        const std::size_t size = command.data_length() / 2;
+        const region* r = find(address, size);
+        if (!r || !r->writable || (!r->memory && !r->read))
+            return status_t::not_authorised;
+        const uint64_t offset = address - r->address;
+        if (r->memory)
+            std::memcpy(old, r->memory + offset, size);
+        else if (const status_t status = r->read(offset, old, size, true);
+                 status != status_t::success)
+            return status;
+        const unsigned char* data = command.data();
+        const unsigned char* mask = data + size;
+        unsigned char value[4];
+        for (std::size_t i = 0; i < size; i++)
+            value[i] = (data[i] & mask[i]) | (old[i] & ~mask[i]);
+        if (!r->memory)
+            return r->write(offset, value, size, true);
+        std::memcpy(r->memory + offset, value, size);
+        return status_t::success;
+    }
+
+    unsigned char m_logical_address;
+    unsigned char m_key;
+    std::vector<region> m_regions;
+};
+
+}
@@ -0,0 +1,168 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SPACEWIREPP_HAS_TSC 1
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+/*
+ * Monotonic timestamps cheap enough to take for every packet.
+ *
+ * On x86 with an invariant TSC a timestamp is a single RDTSC, elsewhere it is CLOCK_MONOTONIC_RAW
+ * read through the vDSO; neither enters the kernel. Timestamps are raw ticks, converted to
+ * nanoseconds with a calibration against CLOCK_MONOTONIC_RAW made once, on first conversion,
+ * from two (ticks, nanoseconds) pairs a couple of milliseconds apart. Each pair keeps the
+ * tightest of a few bracketing reads so preemption between the two clock reads does not skew it.
+ */
+
+namespace spacewire
+{
+
+using timestamp_t = uint64_t;
+
+namespace details::timestamp
+{
+    inline int64_t monotonic_raw_ns() noexcept
+    {
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return int64_t { ts.tv_sec } * 1000000000 + ts.tv_nsec;
+    }
+
+#ifdef SPACEWIREPP_HAS_TSC
+    inline bool has_invariant_tsc() noexcept
+    {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+            return false;
+        __cpuid(0x80000007, eax, ebx, ecx, edx);
+        return edx & (1u << 8);
+    }
+
+    inline const bool use_tsc = has_invariant_tsc();
+#endif
+
+    struct sample
+    {
+        timestamp_t ticks;
+        int64_t ns;
+    };
+}
+
+class timestamp_clock
+{
+public:
+    struct calibration
+    {
+        timestamp_t tick_origin = 0;
+        int64_t ns_origin = 0;
+        double ns_per_tick = 1.;
+    };
+
+    static timestamp_t now() noexcept
+    {
+#ifdef SPACEWIREPP_HAS_TSC
+        if (details::timestamp::use_tsc)
+            return __rdtsc();
+#endif
+        return static_cast<timestamp_t>(details::timestamp::monotonic_raw_ns());
+    }
+
+    static bool uses_tsc() noexcept
+    {
+#ifdef SPACEWIREPP_HAS_TSC
+        return details::timestamp::use_tsc;
+#else
+        return false;
+#endif
+    }
+
+    /*
+     * Measures the tick rate over window, identity when ticks already are nanoseconds.
+     */
+    static calibration calibrate(std::chrono::microseconds window = std::chrono::milliseconds { 2 })
+    {
+        if (!uses_tsc())
+            return calibration {};
+        const auto first = sample();
+        const int64_t end = first.ns
+            + std::chrono::duration_cast<std::chrono::nanoseconds>(window).count();
+        while (details::timestamp::monotonic_raw_ns() < end)
+        {
+        }
+        const auto last = sample();
+        return calibration { first.ticks, first.ns,
+            static_cast<double>(last.ns - first.ns)
+                / static_cast<double>(last.ticks - first.ticks) };
+    }
+
+    static const calibration& current_calibration()
+    {
+        static const calibration c = calibrate();
+        return c;
+    }
+
+    /*
+     * CLOCK_MONOTONIC_RAW time of a timestamp, in nanoseconds.
+     */
+    static int64_t to_ns(timestamp_t t) noexcept
+    {
+        const auto& c = current_calibration();
+        return c.ns_origin
+            + static_cast<int64_t>(
+                static_cast<double>(static_cast<int64_t>(t - c.tick_origin)) * c.ns_per_tick);
+    }
+
+    static std::chrono::nanoseconds elapsed(timestamp_t from, timestamp_t to) noexcept
+    {
+        return std::chrono::nanoseconds { static_cast<int64_t>(
+            static_cast<double>(static_cast<int64_t>(to - from))
+            * current_calibration().ns_per_tick) };
+    }
+
+private:
+    static details::timestamp::sample sample() noexcept
+    {
+        details::timestamp::sample best { 0, 0 };
+        int64_t best_width = INT64_MAX;
+        for (int i = 0; i < 5; i++)
+        {
+            const int64_t before = details::timestamp::monotonic_raw_ns();
+            const timestamp_t ticks = now();
+            const int64_t after = details::timestamp::monotonic_raw_ns();
+            if (after - before < best_width)
+            {
+                best_width = after - before;
+                best = { ticks, before + (after - before) / 2 };
+            }
+        }
+        return best;
+    }
+};
+
+}
@@ -0,0 +1,176 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "events.hpp"
+#include "link.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace spacewire
+{
+
+/*
+ * Link decorator timestamping every packet and time-code at the edge: sends are stamped right
+ * before being handed to the wrapped link, receives right after it returns them. Each is
+ * published to events along with what the wrapped link itself reports (received time-codes,
+ * state changes, errors), so one channel holds a single timeline of the link.
+ * Timestamps are timestamp_clock ticks, taking them costs no system call.
+ */
+class timestamped_link : public link
+{
+public:
+    timestamped_link(link& wrapped, event_channel& events)
+            : m_wrapped { wrapped }, m_events { events }
+    {
+        m_wrapped.set_event_channel(&m_events);
+    }
+    ~timestamped_link() override { m_wrapped.set_event_channel(nullptr); }
+
+    timestamped_link(timestamped_link&&) = delete;
+    timestamped_link& operator=(timestamped_link&&) = delete;
+
+    using link::send;
+    bool send(const const_buffer* buffers, std::size_t count) override
+    {
+        const auto timestamp = timestamp_clock::now();
+        if (!m_wrapped.send(buffers, count))
+            return false;
+        m_events.publish(packet_event(event_kind::packet_sent, timestamp, buffers, count));
+        return true;
+    }
+
+    std::size_t send_packets(const const_buffer* packets, std::size_t count) override
+    {
+        const auto timestamp = timestamp_clock::now();
+        const auto sent = m_wrapped.send_packets(packets, count);
+        for (std::size_t i = 0; i < sent; i++)
+            m_events.publish(packet_event(event_kind::packet_sent, timestamp, packets + i, 1));
+        return sent;
+    }
+
+    std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        const auto size = m_wrapped.receive(buffer, capacity, timeout);
+        if (size && *size)
+            publish_received(timestamp_clock::now(), buffer, std::min(*size, capacity), *size);
+        return size;
+    }
+
+    std::optional<std::size_t> receive_packets(const mutable_buffer* buffers,
+        std::size_t* sizes, std::size_t count, std::chrono::milliseconds timeout) override
+    {
+        const auto received = m_wrapped.receive_packets(buffers, sizes, count, timeout);
+        if (received && *received)
+        {
+            const auto timestamp = timestamp_clock::now();
+            for (std::size_t i = 0; i < *received; i++)
+                publish_received(timestamp, buffers[i].data,
+                    std::min(sizes[i], buffers[i].size), sizes[i]);
+        }
+        return received;
+    }
+
+    std::optional<receive_lease> lease(std::chrono::milliseconds timeout) override
+    {
+        auto lease = m_wrapped.lease(timeout);
+        if (lease && *lease)
+            publish_received(timestamp_clock::now(), lease->data(), lease->size(),
+                lease->size());
+        return lease;
+    }
+
+    bool can_peek() const override { return m_wrapped.can_peek(); }
+
+    // peeked packets are published once actually received
+    std::optional<std::size_t> peek(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        return m_wrapped.peek(buffer, capacity, timeout);
+    }
+
+    std::optional<std::size_t> receive_scatter(const mutable_buffer* buffers, std::size_t count,
+        std::chrono::milliseconds timeout) override
+    {
+        const auto size = m_wrapped.receive_scatter(buffers, count, timeout);
+        if (size && *size)
+        {
+            auto event = packet_event(
+                event_kind::packet_received, timestamp_clock::now(), buffers, count, *size);
+            event.size = static_cast<uint32_t>(*size);
+            m_events.publish(event);
+        }
+        return size;
+    }
+
+    bool send_time_code(time_code code) override
+    {
+        const auto timestamp = timestamp_clock::now();
+        if (!m_wrapped.send_time_code(code))
+            return false;
+        m_events.publish(link_event::time_code_event(event_kind::time_code_sent, timestamp, code));
+        return true;
+    }
+
+    // the channel is fixed at construction
+    void set_event_channel(event_channel*) override { }
+
+    link& wrapped() { return m_wrapped; }
+
+private:
+    // the packet is the concatenation of count buffers, only its first size bytes are there
+    template <typename buffer_t>
+    static link_event packet_event(event_kind kind, timestamp_t timestamp, const buffer_t* buffers,
+        std::size_t count, std::size_t size = SIZE_MAX)
+    {
+        link_event event;
+        event.timestamp = timestamp;
+        event.kind = kind;
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < count && offset < size; i++)
+        {
+            if (offset < link_event::head_size)
+                std::copy_n(buffers[i].data,
+                    std::min({ buffers[i].size, link_event::head_size - offset, size - offset }),
+                    std::begin(event.head) + offset);
+            offset += std::min(buffers[i].size, size - offset);
+        }
+        event.size = static_cast<uint32_t>(std::min(offset, size));
+        return event;
+    }
+
+    void publish_received(timestamp_t timestamp, const unsigned char* data,
+        std::size_t available, std::size_t size)
+    {
+        auto event = link_event::packet(event_kind::packet_received, timestamp, data, available);
+        event.size = static_cast<uint32_t>(size);
+        m_events.publish(event);
+    }
+
+    link& m_wrapped;
+    event_channel& m_events;
+};
+
+}
@@ -0,0 +1,177 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "freelist.hpp"
+#include "rmap.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace spacewire::rmap
+{
+
+/*
+ * Bookkeeping of outstanding RMAP transactions.
+ *
+ * Transaction identifiers are handed out from a lock-free freelist over [0, capacity) and index
+ * directly a flat table of pending entries, so matching a reply is a single array access.
+ *
+ * Threading model:
+ *  - acquire() and cancel() can be called concurrently from any number of threads,
+ *  - complete() and expire() must be called from a single receive thread.
+ *
+ * Identifiers of expired transactions are quarantined until the next expire() call, so a late
+ * reply cannot be matched with a new transaction reusing the same identifier.
+ */
+template <typename context_t>
+class transaction_table
+{
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr std::size_t max_capacity = 1 << 16;
+
+    explicit transaction_table(std::size_t capacity = max_capacity)
+            : m_free { std::min(capacity, max_capacity) }
+            , m_entries { new entry[std::min(capacity, max_capacity)] }
+    {
+        m_quarantine.reserve(m_free.capacity());
+    }
+
+    transaction_table(const transaction_table&) = delete;
+    transaction_table& operator=(const transaction_table&) = delete;
+
+    /*
+     * Returns std::nullopt when every identifier is in use, context is left untouched in this
+     * case so the caller can retry with it.
+     */
+    template <typename T>
+    std::optional<uint16_t> acquire(T&& context, clock::time_point deadline)
+    {
+        auto tid = m_free.pop();
+        if (!tid)
+            return std::nullopt;
+        auto& e = m_entries[*tid];
+        e.context = std::forward<T>(context);
+        e.deadline = deadline;
+        e.state.store(pending, std::memory_order_release);
+        m_in_flight.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<uint16_t>(*tid);
+    }
+
+    /*
+     * Gives back an identifier obtained with acquire() whose request could not be sent.
+     */
+    std::optional<context_t> cancel(uint16_t transaction_id) { return complete(transaction_id); }
+
+    /*
+     * Returns the context of the matching pending transaction and releases its identifier, or
+     * std::nullopt if no transaction with this identifier is pending.
+     */
+    std::optional<context_t> complete(uint16_t transaction_id)
+    {
+        if (transaction_id >= m_free.capacity())
+            return std::nullopt;
+        auto& e = m_entries[transaction_id];
+        if (!e.release())
+            return std::nullopt;
+        std::optional<context_t> context { std::move(e.context) };
+        m_in_flight.fetch_sub(1, std::memory_order_relaxed);
+        m_free.push(transaction_id);
+        return context;
+    }
+
+    std::optional<context_t> complete(const unsigned char* reply)
+    {
+        return complete(static_cast<uint16_t>(fields::transaction_idetifier(reply)));
+    }
+
+    /*
+     * Context of the pending transaction with this identifier, left pending, or nullptr.
+     * Receive thread only, the context stays valid until it completes or expires the transaction.
+     */
+    const context_t* find(uint16_t transaction_id) const
+    {
+        if (transaction_id >= m_free.capacity())
+            return nullptr;
+        const auto& e = m_entries[transaction_id];
+        return e.state.load(std::memory_order_acquire) == pending ? &e.context : nullptr;
+    }
+
+    /*
+     * Calls on_timeout(transaction_id, context) for every pending transaction whose deadline is
+     * before now and returns how many transactions expired.
+     */
+    template <typename callback_t>
+    std::size_t expire(clock::time_point now, callback_t&& on_timeout)
+    {
+        for (auto tid : m_quarantine)
+            m_free.push(tid);
+        m_quarantine.clear();
+        if (m_in_flight.load(std::memory_order_relaxed) == 0)
+            return 0;
+        for (std::size_t tid = 0; tid < m_free.capacity(); tid++)
+        {
+            auto& e = m_entries[tid];
+            if (e.state.load(std::memory_order_acquire) == pending && e.deadline <= now
+                && e.release())
+            {
+                m_in_flight.fetch_sub(1, std::memory_order_relaxed);
+                m_quarantine.push_back(static_cast<uint16_t>(tid));
+                on_timeout(static_cast<uint16_t>(tid), std::move(e.context));
+            }
+        }
+        return std::size(m_quarantine);
+    }
+
+    std::size_t in_flight() const { return m_in_flight.load(std::memory_order_relaxed); }
+    std::size_t capacity() const { return m_free.capacity(); }
+
+private:
+    static constexpr unsigned char idle = 0;
+    static constexpr unsigned char pending = 1;
+
+    struct entry
+    {
+        std::atomic<unsigned char> state { idle };
+
+        // Only one of complete(), cancel() or expire() can win a pending transaction
+        bool release()
+        {
+            unsigned char expected = pending;
+            return state.compare_exchange_strong(
+                expected, idle, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+        clock::time_point deadline;
+        context_t context;
+    };
+
+    index_freelist m_free;
+    std::unique_ptr<entry[]> m_entries;
+    std::vector<uint16_t> m_quarantine;
+    alignas(64) std::atomic<std::size_t> m_in_flight { 0 };
+};
+
+}
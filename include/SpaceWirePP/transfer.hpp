@@ -0,0 +1,156 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "client.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace spacewire::rmap
+{
+
+struct transfer_config
+{
+    // bytes per transaction, at most 2^24 - 1 and usually much lower on real targets
+    std::size_t chunk_size = 4096;
+    // transactions of this transfer in flight, bounded by the client window too
+    std::size_t window = 16;
+    // additional attempts for each failed chunk
+    std::size_t max_retries = 3;
+};
+
+struct transfer_result
+{
+    std::size_t chunks = 0;
+    std::size_t retries = 0;
+    std::size_t failed_chunks = 0;
+    transaction_error last_error = transaction_error::none;
+    status_t last_status = status_t::success;
+
+    bool ok() const { return failed_chunks == 0; }
+};
+
+namespace details
+{
+    /*
+     * Issues chunks of [0, size) up to config.window at a time and retries failed ones.
+     * issue(offset, length, done) must start a transaction and call done(error, status) once.
+     */
+    template <typename issue_t>
+    transfer_result split_transfer(std::size_t size, const transfer_config& config, issue_t&& issue)
+    {
+        const std::size_t chunk_size
+            = std::clamp<std::size_t>(config.chunk_size, 1, (std::size_t { 1 } << 24) - 1);
+        const std::size_t window = std::max<std::size_t>(config.window, 1);
+        struct chunk
+        {
+            std::size_t offset;
+            std::size_t length;
+            std::size_t attempts;
+        };
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<chunk> todo;
+        std::size_t in_flight = 0;
+        transfer_result result;
+        for (std::size_t offset = 0; offset < size; offset += chunk_size)
+            todo.push_back({ offset, std::min(chunk_size, size - offset), 0 });
+        result.chunks = std::size(todo);
+
+        std::unique_lock<std::mutex> lock { mutex };
+        while (!todo.empty() || in_flight)
+        {
+            cv.wait(lock, [&]() { return (!todo.empty() && in_flight < window) || !in_flight; });
+            if (todo.empty())
+                continue;
+            const chunk c = todo.front();
+            todo.pop_front();
+            in_flight++;
+            lock.unlock();
+            issue(c.offset, c.length,
+                [&, c](transaction_error error, status_t status)
+                {
+                    std::lock_guard<std::mutex> guard { mutex };
+                    in_flight--;
+                    if (error != transaction_error::none || status != status_t::success)
+                    {
+                        result.last_error = error;
+                        result.last_status = status;
+                        if (c.attempts < config.max_retries)
+                        {
+                            result.retries++;
+                            todo.push_back({ c.offset, c.length, c.attempts + 1 });
+                        }
+                        else
+                            result.failed_chunks++;
+                    }
+                    cv.notify_one();
+                });
+            lock.lock();
+        }
+        return result;
+    }
+}
+
+/*
+ * Reads [address, address + size) into destination using as many transactions as needed.
+ * Each chunk is read with client::read_into() to its place in destination, so replies land there
+ * as they arrive, in any order, and only failed chunks are read again.
+ */
+inline transfer_result read_region(client& client, uint32_t address, unsigned char* destination,
+    std::size_t size, const transfer_config& config = {})
+{
+    return details::split_transfer(size, config,
+        [&](std::size_t offset, std::size_t length, auto done)
+        {
+            client.read_into(static_cast<uint32_t>(address + offset), destination + offset,
+                static_cast<uint32_t>(length),
+                [length, done](const read_reply& reply)
+                {
+                    if (reply.ok() && reply.size == length)
+                        done(transaction_error::none, status_t::success);
+                    else if (reply.ok())
+                        done(transaction_error::invalid_reply, reply.status);
+                    else
+                        done(reply.error, reply.status);
+                });
+        });
+}
+
+/*
+ * Writes [source, source + size) to [address, address + size) using as many transactions as
+ * needed, only failed chunks are written again.
+ */
+inline transfer_result write_region(client& client, uint32_t address,
+    const unsigned char* source, std::size_t size, const transfer_config& config = {})
+{
+    return details::split_transfer(size, config,
+        [&](std::size_t offset, std::size_t length, auto done)
+        {
+            client.write(static_cast<uint32_t>(address + offset), source + offset,
+                static_cast<uint32_t>(length),
+                [done](const write_reply& reply) { done(reply.error, reply.status); });
+        });
+}
+
+}
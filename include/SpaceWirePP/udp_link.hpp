@@ -0,0 +1,134 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "socket_link.hpp"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <utility>
+
+namespace spacewire
+{
+
+/*
+ * Link over a connected IPv4 UDP socket, one SpaceWire packet per datagram.
+ * Packets are limited to 65507 bytes and, unlike a SpaceWire link, UDP may drop packets when
+ * the receiver falls behind; buffer_size enlarges the socket buffers to absorb bursts.
+ * shutdown() unblocks a pending receive() on this endpoint only, the peer is not notified.
+ */
+class udp_link : public socket_link
+{
+public:
+    using socket_link::socket_link;
+
+    /*
+     * Socket bound to local_address:local_port and connected to remote_address:remote_port,
+     * addresses are dotted IPv4 strings and a zero local port picks an ephemeral one.
+     * Returns a closed link on failure.
+     */
+    static udp_link open(const char* local_address, uint16_t local_port,
+        const char* remote_address, uint16_t remote_port, int buffer_size = 0)
+    {
+        const auto local = address(local_address, local_port);
+        const auto remote = address(remote_address, remote_port);
+        if (!local || !remote)
+            return udp_link { -1 };
+        udp_link result { bound_socket(*local, buffer_size) };
+        if (result.is_open() && !connect(result.fd(), *remote))
+            result.close();
+        return result;
+    }
+
+    /*
+     * Two endpoints on 127.0.0.1 connected to each other, returns two closed links on failure.
+     */
+    static std::pair<udp_link, udp_link> make_pair(int buffer_size = 0)
+    {
+        const auto any = address("127.0.0.1", 0);
+        udp_link a { bound_socket(*any, buffer_size) };
+        udp_link b { bound_socket(*any, buffer_size) };
+        const auto a_address = bound_address(a.fd());
+        const auto b_address = bound_address(b.fd());
+        if (!a_address || !b_address || !connect(a.fd(), *b_address)
+            || !connect(b.fd(), *a_address))
+            return { udp_link { -1 }, udp_link { -1 } };
+        return { std::move(a), std::move(b) };
+    }
+
+    /*
+     * Local port of the socket, 0 when closed.
+     */
+    uint16_t port() const
+    {
+        const auto local = bound_address(fd());
+        return local ? ntohs(local->sin_port) : 0;
+    }
+
+private:
+    static std::optional<sockaddr_in> address(const char* host, uint16_t port)
+    {
+        sockaddr_in result {};
+        result.sin_family = AF_INET;
+        result.sin_port = htons(port);
+        if (::inet_pton(AF_INET, host, &result.sin_addr) != 1)
+            return std::nullopt;
+        return result;
+    }
+
+    static std::optional<sockaddr_in> bound_address(int fd)
+    {
+        if (fd < 0)
+            return std::nullopt;
+        sockaddr_in result {};
+        socklen_t size = sizeof(result);
+        if (::getsockname(fd, reinterpret_cast<sockaddr*>(&result), &size) != 0)
+            return std::nullopt;
+        return result;
+    }
+
+    static int bound_socket(const sockaddr_in& local, int buffer_size)
+    {
+        const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        if (buffer_size > 0)
+        {
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+        }
+        if (::bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static bool connect(int fd, const sockaddr_in& remote)
+    {
+        return fd >= 0
+            && ::connect(fd, reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)) == 0;
+    }
+};
+
+}
@@ -0,0 +1,50 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SpaceWire++ Library
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "socket_link.hpp"
+#include <sys/socket.h>
+#include <utility>
+
+namespace spacewire
+{
+
+/*
+ * Link over a packet preserving UNIX socket (SOCK_SEQPACKET or SOCK_DGRAM).
+ */
+class unix_socket_link : public socket_link
+{
+public:
+    using socket_link::socket_link;
+
+    /*
+     * Connected pair of endpoints, returns two closed links on failure.
+     */
+    static std::pair<unix_socket_link, unix_socket_link> make_pair()
+    {
+        int fds[2] = { -1, -1 };
+        if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0)
+            return { unix_socket_link { -1 }, unix_socket_link { -1 } };
+        return { unix_socket_link { fds[0] }, unix_socket_link { fds[1] } };
+    }
+};
+
+}
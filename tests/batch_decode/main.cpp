@@ -0,0 +1,112 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/batch_decode.hpp>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+void append_record(std::vector<unsigned char>& capture, const unsigned char* packet, uint32_t size)
+{
+    for (int i = 0; i < 4; i++)
+        capture.push_back(static_cast<unsigned char>(size >> (8 * i)));
+    capture.insert(std::end(capture), packet, packet + size);
+}
+
+std::vector<unsigned char> read_reply(uint16_t tid, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> packet { 0x67, 0x01, 0b00001100, 0x00, 0xFE,
+        static_cast<unsigned char>(tid >> 8), static_cast<unsigned char>(tid), 0x00, 0x00,
+        static_cast<unsigned char>(data.size() >> 8), static_cast<unsigned char>(data.size()) };
+    packet.push_back(spacewire::crc(packet.data(), packet.size()));
+    packet.insert(std::end(packet), std::cbegin(data), std::cend(data));
+    packet.push_back(spacewire::crc(data.data(), data.size()));
+    return packet;
+}
+}
+
+SCENARIO("Batch decoding of RMAP captures", "[]")
+{
+    using namespace spacewire::rmap;
+    GIVEN("a capture of mixed packets")
+    {
+        std::vector<unsigned char> capture;
+        std::vector<unsigned char> data(100);
+        std::iota(std::begin(data), std::end(data), 0);
+        const std::size_t count = 1000;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::vector<unsigned char> packet;
+            switch (i % 4)
+            {
+                case 0:
+                    packet.resize(read_request_buffer_size());
+                    build_read_request(0xFE, 2, 0x67, 0x1000 * i, i, 64 + i, packet);
+                    break;
+                case 1:
+                    packet.resize(write_request_buffer_size(data.size()));
+                    build_write_request(
+                        0xFE, 2, 0x67, 0x1000 * i, i, data.data(), data.size(), packet);
+                    break;
+                case 2:
+                    packet = read_reply(i, data);
+                    break;
+                case 3:
+                    packet = { 0xFE, 0x02, 0x00, 0x00, 0x08 };
+                    break;
+            }
+            if (i % 10 == 5 || i % 10 == 8)
+                packet.back() ^= 0xFF;
+            append_record(capture, packet.data(), packet.size());
+        }
+        packet_columns columns;
+        const auto consumed = decode_capture(capture.data(), capture.size(), columns);
+        REQUIRE(consumed == capture.size());
+        REQUIRE(columns.count() == count);
+        THEN("columns match the packet view decoding")
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                packet_view view { capture.data() + columns.offset[i], columns.size[i] };
+                REQUIRE(columns.kind[i] == view.kind());
+                REQUIRE(columns.transaction_id[i] == view.transaction_id());
+                REQUIRE(columns.data_length[i] == view.data_length());
+                if (view.is_command())
+                {
+                    REQUIRE(columns.address[i] == view.address());
+                    REQUIRE(columns.status[i] == view.key());
+                }
+                if (view.kind() != packet_kind::invalid)
+                {
+                    REQUIRE(columns.packet_type[i] == view.packet_type());
+                    REQUIRE(columns.header_crc_valid[i] == view.header_crc_valid());
+                    REQUIRE(columns.data_crc_valid[i] == view.valid());
+                }
+            }
+        }
+        THEN("corrupted packets are flagged")
+        {
+            REQUIRE_FALSE(columns.data_crc_valid[5]);
+            REQUIRE(columns.header_crc_valid[5]);
+            REQUIRE_FALSE(columns.header_crc_valid[8]);
+            REQUIRE(columns.transaction_id[6] == 6);
+            REQUIRE(columns.address[4] == 0x4000);
+        }
+        WHEN("the capture is truncated")
+        {
+            packet_columns partial;
+            const auto consumed = decode_capture(capture.data(), capture.size() - 3, partial);
+            REQUIRE(partial.count() == count - 1);
+            REQUIRE(consumed == columns.offset.back() - 4);
+        }
+    }
+}
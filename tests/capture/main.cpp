@@ -0,0 +1,131 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/capture.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+std::string temporary_path(const char* name)
+{
+    return std::string { "/tmp/spacewirepp_" } + std::to_string(::getpid()) + "_" + name;
+}
+}
+
+SCENARIO("Capture files", "[]")
+{
+    using namespace spacewire::rmap;
+    const std::string path = temporary_path("capture.spw");
+    const std::string index = path + ".idx";
+    std::vector<unsigned char> data(64);
+    std::iota(std::begin(data), std::end(data), 0);
+    const std::size_t count = 1000;
+    {
+        auto writer = capture_writer::create(path.c_str(), 4096);
+        REQUIRE(writer);
+        std::vector<unsigned char> packet(write_request_buffer_size(data.size()));
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const uint16_t tid = static_cast<uint16_t>(i % 100);
+            std::size_t size = 0;
+            if (i % 2)
+                size = *build_write_request(
+                    0xFE, 2, 0x67, 0x1000 * (count - i), tid, data.data(), data.size(), packet);
+            else
+                size = *build_read_request(0xFE, 2, 0x67, 0x1000 * (count - i), tid, 16, packet);
+            REQUIRE(writer.append(std::chrono::nanoseconds { 10 * i }, packet.data(), size));
+        }
+        REQUIRE_FALSE(writer.append(0ns, packet.data(), 16));
+        std::vector<unsigned char> large(8192, 0x55);
+        REQUIRE(writer.append(10us, large.data(), large.size()));
+        REQUIRE(writer.count() == count + 1);
+        REQUIRE(writer.close());
+    }
+    GIVEN("a capture and its index")
+    {
+        auto reader = capture_reader::open(path.c_str());
+        REQUIRE(reader);
+        REQUIRE(reader.index_mapped());
+        REQUIRE(reader.size() == count + 1);
+        THEN("records are zero copy views of the packets")
+        {
+            std::size_t i = 0;
+            for (const auto record : reader)
+            {
+                if (i == count)
+                {
+                    REQUIRE(record.size == 8192);
+                    REQUIRE(record.timestamp == 10us);
+                    break;
+                }
+                const auto view = record.view();
+                REQUIRE(view.valid());
+                REQUIRE(record.timestamp == std::chrono::nanoseconds { 10 * i });
+                REQUIRE(view.transaction_id() == i % 100);
+                REQUIRE(uint32_t(fields::address(record.data)) == 0x1000 * (count - i));
+                REQUIRE(reader.entry(i).kind
+                    == (i % 2 ? packet_kind::write_command : packet_kind::read_command));
+                i++;
+            }
+        }
+        THEN("records can be found by time")
+        {
+            REQUIRE(reader.seek(0ns) == 0);
+            REQUIRE(reader.seek(55ns) == 6);
+            REQUIRE(reader.seek(60ns) == 6);
+            REQUIRE(reader.seek(1h) == reader.size());
+        }
+        THEN("records can be found by transaction identifier")
+        {
+            const auto range = reader.find_transaction(42);
+            REQUIRE(range.size() == 10);
+            std::size_t expected = 42;
+            for (const auto index : range)
+            {
+                REQUIRE(index == expected);
+                expected += 100;
+            }
+            REQUIRE(reader.find_transaction(100).empty());
+        }
+        THEN("commands can be found by address")
+        {
+            const auto range = reader.find_address(0x1000 * 10, 0x1000 * 20);
+            REQUIRE(range.size() == 10);
+            for (const auto index : range)
+                REQUIRE(reader.entry(index).address >= 0x1000 * 10);
+            REQUIRE(reader[*range.begin()].view().address() == 0x1000 * 10);
+        }
+    }
+    GIVEN("a capture without index")
+    {
+        std::remove(index.c_str());
+        auto reader = capture_reader::open(path.c_str());
+        REQUIRE(reader);
+        REQUIRE_FALSE(reader.index_mapped());
+        REQUIRE(reader.size() == count + 1);
+        REQUIRE(reader.find_transaction(7).size() == 10);
+        REQUIRE(reader[999].view().transaction_id() == 99);
+    }
+    GIVEN("a file which is not a capture")
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        std::fputs("not a capture file", file);
+        std::fclose(file);
+        REQUIRE_FALSE(capture_reader::open(path.c_str()));
+    }
+    std::remove(path.c_str());
+    std::remove(index.c_str());
+}
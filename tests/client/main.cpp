@@ -0,0 +1,273 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/client.hpp>
+#include <SpaceWirePP/target.hpp>
+#include <SpaceWirePP/transfer.hpp>
+#include <SpaceWirePP/unix_socket_link.hpp>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+// Target answering from a flat memory, replies are sent in reverse order by batches to
+// exercise out of order completion.
+void serve(spacewire::link& link, std::vector<unsigned char>& memory, std::size_t batch)
+{
+    spacewire::rmap::target target { 0xFE, 0 };
+    target.map_memory(0, memory.data(), memory.size());
+    std::vector<unsigned char> buffer(1 << 16);
+    std::vector<std::vector<unsigned char>> replies;
+    while (true)
+    {
+        auto size = link.receive(buffer.data(), buffer.size(), 5ms);
+        if (!size)
+            break;
+        if (*size == 0 || replies.size() == batch)
+        {
+            while (!replies.empty())
+            {
+                link.send(replies.back().data(), replies.back().size());
+                replies.pop_back();
+            }
+        }
+        if (*size == 0)
+            continue;
+        std::vector<unsigned char> reply(1 << 16);
+        reply.resize(target.handle(buffer.data(), *size, reply.data(), reply.size()));
+        if (!reply.empty())
+            replies.push_back(std::move(reply));
+    }
+}
+
+// Drops one request out of every n
+struct lossy_link : spacewire::link
+{
+    lossy_link(spacewire::link& link, std::size_t n) : wrapped { link }, n { n } { }
+
+    bool send(const spacewire::const_buffer* buffers, std::size_t count) override
+    {
+        if (++sent % n == 0)
+            return true;
+        return wrapped.send(buffers, count);
+    }
+
+    std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        return wrapped.receive(buffer, capacity, timeout);
+    }
+
+    spacewire::link& wrapped;
+    std::size_t n;
+    std::atomic<std::size_t> sent { 0 };
+};
+
+// Flips the first data byte of every packet carrying data
+struct corrupting_link : spacewire::link
+{
+    explicit corrupting_link(spacewire::link& link) : wrapped { link } { }
+
+    bool send(const spacewire::const_buffer* buffers, std::size_t count) override
+    {
+        std::vector<unsigned char> packet;
+        for (std::size_t i = 0; i < count; i++)
+            packet.insert(std::end(packet), buffers[i].data, buffers[i].data + buffers[i].size);
+        if (std::size(packet) > 13)
+            packet[12] ^= 0xFF;
+        return wrapped.send(packet.data(), std::size(packet));
+    }
+
+    std::optional<std::size_t> receive(
+        unsigned char* buffer, std::size_t capacity, std::chrono::milliseconds timeout) override
+    {
+        return wrapped.receive(buffer, capacity, timeout);
+    }
+
+    spacewire::link& wrapped;
+};
+
+void disconnect(spacewire::loopback_link& link)
+{
+    link.close();
+}
+
+void disconnect(spacewire::unix_socket_link& link)
+{
+    link.shutdown();
+}
+
+template <typename link_t>
+void check_client(link_t& initiator, link_t& target_link)
+{
+    using namespace spacewire::rmap;
+    std::vector<unsigned char> memory(1 << 16);
+    std::iota(std::begin(memory), std::end(memory), 0);
+    std::thread target { [&]() { serve(target_link, memory, 8); } };
+    {
+        client c { initiator, client_config { 0xFE, 0, 0x20, 16, 1000ms, 5ms, 1 << 16 } };
+        THEN("pipelined reads complete with the right data")
+        {
+            std::vector<std::future<read_result>> reads;
+            for (uint32_t i = 0; i < 200; i++)
+                reads.push_back(c.read(i * 64, 64));
+            for (uint32_t i = 0; i < 200; i++)
+            {
+                auto result = reads[i].get();
+                REQUIRE(result.ok());
+                REQUIRE(result.data
+                    == std::vector<unsigned char>(memory.data() + i * 64,
+                        memory.data() + (i + 1) * 64));
+            }
+        }
+        THEN("reads land in their destination, large ones straight from the link")
+        {
+            std::vector<unsigned char> destination(1 << 16);
+            std::vector<std::future<read_reply>> reads;
+            for (uint32_t i = 0; i < 8; i++)
+                reads.push_back(
+                    c.read_into(i * 8192, destination.data() + i * 8192, i % 2 ? 8192 : 64));
+            for (uint32_t i = 0; i < 8; i++)
+            {
+                auto reply = reads[i].get();
+                REQUIRE(reply.ok());
+                REQUIRE(reply.data == destination.data() + i * 8192);
+                REQUIRE(reply.size == (i % 2 ? 8192u : 64u));
+                REQUIRE(std::equal(reply.data, reply.data + reply.size, memory.data() + i * 8192));
+            }
+        }
+        THEN("writes are applied")
+        {
+            std::vector<unsigned char> data(1000, 0x42);
+            REQUIRE(c.write(0x100, data.data(), data.size()).get().ok());
+            REQUIRE(std::all_of(memory.data() + 0x100, memory.data() + 0x100 + 1000,
+                [](auto v) { return v == 0x42; }));
+        }
+    }
+    disconnect(target_link);
+    disconnect(initiator);
+    target.join();
+}
+}
+
+SCENARIO("RMAP client", "[]")
+{
+    using namespace spacewire::rmap;
+    GIVEN("a loopback link")
+    {
+        auto [initiator, target_link] = spacewire::loopback_link::make_pair();
+        check_client(initiator, target_link);
+    }
+    GIVEN("a UNIX socket pair")
+    {
+        auto [initiator, target_link] = spacewire::unix_socket_link::make_pair();
+        REQUIRE(initiator.is_open());
+        check_client(initiator, target_link);
+    }
+    GIVEN("a link without target")
+    {
+        auto [initiator, target_link] = spacewire::loopback_link::make_pair();
+        client c { initiator, client_config { 0xFE, 0, 0x20, 4, 20ms, 5ms, 1 << 16 } };
+        THEN("requests time out")
+        {
+            std::vector<std::future<read_result>> reads;
+            for (int i = 0; i < 10; i++)
+                reads.push_back(c.read(0, 4));
+            for (auto& read : reads)
+                REQUIRE(read.get().error == transaction_error::timeout);
+            REQUIRE(c.in_flight() == 0);
+        }
+        THEN("pending requests fail when the link is closed")
+        {
+            auto read = c.read(0, 4);
+            target_link.close();
+            REQUIRE(read.get().error == transaction_error::link_error);
+            REQUIRE(c.read(0, 4).get().error == transaction_error::link_error);
+        }
+    }
+    GIVEN("a target corrupting reply data")
+    {
+        auto links = spacewire::loopback_link::make_pair();
+        corrupting_link corrupting { links.second };
+        std::vector<unsigned char> memory(1 << 16);
+        std::thread target { [&]() { serve(corrupting, memory, 1); } };
+        {
+            client c { links.first, client_config { 0xFE, 0, 0x20, 4, 1000ms, 5ms, 1 << 16 } };
+            THEN("replies copied out or received in place are rejected")
+            {
+                std::vector<unsigned char> destination(8192);
+                REQUIRE(c.read_into(0, destination.data(), 64).get().error
+                    == transaction_error::invalid_reply);
+                REQUIRE(c.read_into(0, destination.data(), 8192).get().error
+                    == transaction_error::invalid_reply);
+                REQUIRE(c.read(0, 16).get().error == transaction_error::invalid_reply);
+                REQUIRE(c.in_flight() == 0);
+            }
+        }
+        links.second.close();
+        links.first.close();
+        target.join();
+    }
+}
+
+SCENARIO("RMAP region transfers", "[]")
+{
+    using namespace spacewire::rmap;
+    auto [initiator, target_link] = spacewire::loopback_link::make_pair();
+    std::vector<unsigned char> memory(1 << 16);
+    std::iota(std::begin(memory), std::end(memory), 0);
+    std::thread target { [&, &target_link = target_link]() { serve(target_link, memory, 4); } };
+    GIVEN("a reliable link")
+    {
+        client c { initiator, client_config { 0xFE, 0, 0x20, 16, 1000ms, 5ms, 1 << 16 } };
+        THEN("a region is read in chunks")
+        {
+            std::vector<unsigned char> destination(40000);
+            auto result = read_region(c, 1000, destination.data(), destination.size(),
+                transfer_config { 1000, 8, 0 });
+            REQUIRE(result.ok());
+            REQUIRE(result.chunks == 40);
+            REQUIRE(std::equal(std::cbegin(destination), std::cend(destination),
+                memory.data() + 1000));
+        }
+        THEN("a region is written in chunks")
+        {
+            std::vector<unsigned char> source(10001, 0x55);
+            auto result = write_region(
+                c, 0x2000, source.data(), source.size(), transfer_config { 999, 4, 0 });
+            REQUIRE(result.ok());
+            REQUIRE(result.chunks == 11);
+            REQUIRE(std::equal(std::cbegin(source), std::cend(source), memory.data() + 0x2000));
+        }
+    }
+    GIVEN("a link loosing requests")
+    {
+        lossy_link lossy { initiator, 5 };
+        client c { lossy, client_config { 0xFE, 0, 0x20, 16, 30ms, 5ms, 1 << 16 } };
+        THEN("only failed chunks are retried")
+        {
+            std::vector<unsigned char> destination(20000);
+            auto result = read_region(c, 0, destination.data(), destination.size(),
+                transfer_config { 500, 8, 5 });
+            REQUIRE(result.ok());
+            REQUIRE(result.retries >= 8);
+            REQUIRE(result.retries < 40);
+            REQUIRE(std::equal(
+                std::cbegin(destination), std::cend(destination), std::cbegin(memory)));
+        }
+    }
+    target_link.close();
+    initiator.close();
+    target.join();
+}
@@ -0,0 +1,119 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/command_batch.hpp>
+#include <SpaceWirePP/packet_view.hpp>
+#include <SpaceWirePP/unix_socket_link.hpp>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+SCENARIO("Command batches", "[]")
+{
+    using namespace spacewire::rmap;
+    std::vector<unsigned char> data(13);
+    std::iota(std::begin(data), std::end(data), 1);
+    GIVEN("a batch of reads and writes")
+    {
+        command_batch batch { 0xFE, 0x20, 0x67, {}, 0xFFFE };
+        batch.reserve(300, 300 * 32);
+        for (uint32_t i = 0; i < 300; i++)
+        {
+            if (i % 3)
+                REQUIRE(batch.add_read(0x1000 + 4 * i, 4));
+            else
+                REQUIRE(batch.add_write(0x2000 + 4 * i, data.data(), data.size()));
+        }
+        REQUIRE_FALSE(batch.add_read(0, 1 << 24));
+        batch.seal();
+        REQUIRE(batch.size() == 300);
+        THEN("commands match the single command builders")
+        {
+            for (uint32_t i = 0; i < 300; i++)
+            {
+                const auto tid = static_cast<uint16_t>(0xFFFE + i);
+                REQUIRE(batch[i].transaction_id == tid);
+                std::vector<unsigned char> expected(write_request_buffer_size(data.size()));
+                const auto size = i % 3
+                    ? *build_read_request(0xFE, 0x20, 0x67, 0x1000 + 4 * i, tid, 4, expected)
+                    : *build_write_request(
+                        0xFE, 0x20, 0x67, 0x2000 + 4 * i, tid, data.data(), data.size(), expected);
+                REQUIRE(batch[i].size == size);
+                REQUIRE(std::equal(batch.packet(i), batch.packet(i) + size, expected.data()));
+            }
+            REQUIRE(batch[299].offset + batch[299].size == batch.bytes());
+        }
+        WHEN("it is reset")
+        {
+            batch.reset(7);
+            batch.add_read(0, 4);
+            batch.seal();
+            REQUIRE(batch.size() == 1);
+            REQUIRE(batch[0].transaction_id == 7);
+            REQUIRE(packet_view { batch.packet(0), batch[0].size }.valid());
+        }
+    }
+    GIVEN("a batch with a route and command options")
+    {
+        const unsigned char path[] = { 3, 5 };
+        const unsigned char reply_path[] = { 1, 2, 4, 6, 8 };
+        command_batch batch { 0xFE, 0x20, 0x67, route { path, 2, reply_path, 5 } };
+        batch.add_read<options::none>(0x10, 8, 0x01);
+        batch.add_write<options::verify | options::acknowledge>(0x20, data.data(), data.size());
+        batch.seal();
+        THEN("commands are valid once path bytes are stripped")
+        {
+            const packet_view read { batch.packet(0), batch[0].size, 2 };
+            REQUIRE(read.valid());
+            REQUIRE(read.kind() == packet_kind::read_command);
+            REQUIRE_FALSE(read.increment());
+            REQUIRE(read.full_address() == 0x01'0000'0010);
+            REQUIRE(read.reply_address_size() == 8);
+            const packet_view write { batch.packet(1), batch[1].size, 2 };
+            REQUIRE(write.valid());
+            REQUIRE(write.verify());
+            REQUIRE(write.transaction_id() == 1);
+            REQUIRE(std::equal(std::cbegin(data), std::cend(data), write.data()));
+        }
+    }
+    GIVEN("links")
+    {
+        command_batch batch { 0xFE, 0x20, 0x67 };
+        for (uint32_t i = 0; i < 200; i++)
+            batch.add_write(4 * i, data.data(), data.size());
+        const auto check = [&batch](spacewire::link& receiver)
+        {
+            std::array<unsigned char, 64> packet;
+            for (std::size_t i = 0; i < batch.size(); i++)
+            {
+                const auto size = receiver.receive(packet.data(), packet.size(), 100ms);
+                REQUIRE(size);
+                REQUIRE(*size == batch[i].size);
+                const packet_view view { packet.data(), *size };
+                REQUIRE(view.valid());
+                REQUIRE(view.transaction_id() == i);
+            }
+        };
+        WHEN("sent over a loopback link")
+        {
+            auto links = spacewire::loopback_link::make_pair();
+            REQUIRE(batch.send(links.first) == 200);
+            check(links.second);
+        }
+        WHEN("sent over a UNIX socket")
+        {
+            auto links = spacewire::unix_socket_link::make_pair();
+            REQUIRE(batch.send(links.first) == 200);
+            check(links.second);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <cstdint>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+unsigned char bitwise_crc(const unsigned char* buffer, std::size_t size, unsigned char crc = 0)
+{
+    for (std::size_t i = 0; i < size; i++)
+    {
+        crc ^= buffer[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+    }
+    return crc;
+}
+
+std::vector<unsigned char> random_buffer(std::size_t size)
+{
+    std::mt19937 gen { static_cast<unsigned int>(size) };
+    std::uniform_int_distribution<int> dist { 0, 255 };
+    std::vector<unsigned char> buffer(size);
+    std::generate(std::begin(buffer), std::end(buffer),
+        [&]() { return static_cast<unsigned char>(dist(gen)); });
+    return buffer;
+}
+}
+
+SCENARIO("CRC test vectors", "[]")
+{
+    GIVEN("ECSS-E-ST-50-52C test patterns")
+    {
+        const unsigned char pattern[] { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+        REQUIRE(spacewire::crc(pattern, sizeof(pattern)) == 0xB0);
+        const unsigned char header[] { 0xFE, 0x01, 0x6C, 0x00, 0x67, 0x00, 0x00, 0x00, 0xA0, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x10 };
+        REQUIRE(spacewire::crc(header, sizeof(header)) == 0x9F);
+        const unsigned char data[] { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x10, 0x11,
+            0x12, 0x13, 0x14, 0x15, 0x16, 0x17 };
+        REQUIRE(spacewire::crc(data, sizeof(data)) == 0x56);
+    }
+    GIVEN("the CRC table")
+    {
+        THEN("it matches the bitwise definition")
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                const auto byte = static_cast<unsigned char>(i);
+                REQUIRE(spacewire::CRCTable[i] == bitwise_crc(&byte, 1));
+            }
+        }
+    }
+}
+
+SCENARIO("CRC engines consistency", "[]")
+{
+    for (std::size_t size : { 0, 1, 7, 8, 15, 16, 17, 63, 64, 65, 255, 256, 257, 1000, 4096, 65537 })
+    {
+        const auto buffer = random_buffer(size);
+        const auto expected = bitwise_crc(buffer.data(), size);
+        REQUIRE(spacewire::static_crc(buffer.data(), size) == expected);
+        REQUIRE(spacewire::details::crc::slice_by_16(buffer.data(), size, 0) == expected);
+#ifdef SPACEWIREPP_HAS_CLMUL_CRC
+        if (spacewire::details::crc::has_clmul())
+        {
+            REQUIRE(spacewire::details::crc::clmul(buffer.data(), size, 0) == expected);
+            REQUIRE(spacewire::details::crc::clmul(buffer.data(), size, 0x5A)
+                == bitwise_crc(buffer.data(), size, 0x5A));
+        }
+#endif
+        REQUIRE(spacewire::crc(buffer.data(), size) == expected);
+    }
+}
+
+SCENARIO("Incremental CRC", "[]")
+{
+    const auto buffer = random_buffer(10000);
+    const auto expected = spacewire::crc(buffer.data(), buffer.size());
+    for (std::size_t chunk : { 1, 3, 16, 100, 333, 4096 })
+    {
+        spacewire::crc_state state;
+        for (std::size_t offset = 0; offset < buffer.size(); offset += chunk)
+            state.update(buffer.data() + offset, std::min(chunk, buffer.size() - offset));
+        REQUIRE(state == expected);
+    }
+}
+
+SCENARIO("Copying CRC", "[]")
+{
+    for (std::size_t size : { 0, 1, 255, 4096, 4097, 100000 })
+    {
+        const auto buffer = random_buffer(size);
+        std::vector<unsigned char> destination(size);
+        REQUIRE(spacewire::crc_copy(destination.data(), buffer.data(), size)
+            == spacewire::crc(buffer.data(), size));
+        REQUIRE(destination == buffer);
+        REQUIRE(spacewire::crc_copy(destination.data(), buffer.data(), size, 0x5A)
+            == spacewire::crc(buffer.data(), size, 0x5A));
+    }
+}
+
+SCENARIO("Compile time CRC", "[]")
+{
+    static constexpr std::array<unsigned char, 8> pattern { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+        0x07, 0x08 };
+    static_assert(spacewire::static_crc(pattern) == 0xB0);
+    static_assert(spacewire::crc_state {}.static_update(pattern.data(), 4).static_update(
+                      pattern.data() + 4, 4)
+        == 0xB0);
+    REQUIRE(spacewire::static_crc(pattern) == spacewire::crc(pattern.data(), pattern.size()));
+}
@@ -0,0 +1,128 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/ccsds.hpp>
+#include <SpaceWirePP/dispatch.hpp>
+#include <SpaceWirePP/rmap.hpp>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+SCENARIO("CCSDS packet view", "[]")
+{
+    using namespace spacewire::ccsds;
+    std::vector<unsigned char> data(100);
+    std::iota(std::begin(data), std::end(data), 0);
+    std::vector<unsigned char> packet(packet_buffer_size(data.size()));
+    const auto size = build_packet(0x42, 0x07, packet_type_t::telemetry, true, 0x5A5,
+        sequence_flags_t::unsegmented, 0x3FFF, data.data(), data.size(), packet.data());
+    REQUIRE(size == 110);
+    GIVEN("a well formed packet")
+    {
+        packet_view view { packet.data(), size };
+        REQUIRE(view.valid());
+        REQUIRE(view.target_logical_address() == 0x42);
+        REQUIRE(view.user_application() == 0x07);
+        REQUIRE(view.version() == 0);
+        REQUIRE(view.is_telemetry());
+        REQUIRE(view.secondary_header());
+        REQUIRE(view.apid() == 0x5A5);
+        REQUIRE(view.sequence_flags() == sequence_flags_t::unsegmented);
+        REQUIRE(view.sequence_count() == 0x3FFF);
+        REQUIRE(view.data_size() == data.size());
+        REQUIRE(std::equal(std::cbegin(data), std::cend(data), view.data()));
+        REQUIRE(view.space_packet() == packet.data() + 4);
+        REQUIRE(view.space_packet_size() == 106);
+        REQUIRE(fields::apid(packet.data()) == 0x5A5);
+        REQUIRE(fields::packet_data_length(packet.data()) == 99);
+    }
+    GIVEN("malformed packets")
+    {
+        REQUIRE(packet_view { packet.data(), size - 1 }.error() == packet_error::early_eop);
+        packet.push_back(0);
+        REQUIRE(packet_view { packet.data(), size + 1 }.error() == packet_error::too_much_data);
+        REQUIRE(packet_view { packet.data(), 10 }.error() == packet_error::too_short);
+        packet[1] = 1;
+        REQUIRE(packet_view { packet.data(), size }.error() == packet_error::not_ccsds);
+    }
+}
+
+SCENARIO("Protocol dispatch", "[]")
+{
+    using namespace spacewire;
+    std::vector<unsigned char> data(16, 0xAA);
+    std::vector<unsigned char> ccsds_packet(ccsds::packet_buffer_size(data.size()));
+    ccsds::build_packet(0x42, 0, ccsds::packet_type_t::telemetry, false, 12,
+        ccsds::sequence_flags_t::unsegmented, 7, data.data(), data.size(), ccsds_packet.data());
+    std::vector<unsigned char> rmap_packet(rmap::read_request_buffer_size());
+    rmap::build_read_request(0xFE, 2, 0x67, 0x1000, 33, 64, rmap_packet);
+    const std::vector<unsigned char> stup_packet { 0x42, 239, 1, 2, 3 };
+    const std::vector<unsigned char> goes_packet { 0x42, 238, 1, 2, 3 };
+
+    std::size_t rmap_count = 0, ccsds_count = 0, stup_count = 0, other_count = 0;
+    auto dispatcher = make_dispatcher(
+        on<protocol_id_t::SPW_PROTO_ID_RMAP>(
+            [&](const rmap::packet_view& p)
+            {
+                REQUIRE(p.valid());
+                REQUIRE(p.transaction_id() == 33);
+                rmap_count++;
+            }),
+        on<protocol_id_t::SPW_PROTO_ID_CCSDS>(
+            [&](const ccsds::packet_view& p)
+            {
+                REQUIRE(p.valid());
+                REQUIRE(p.apid() == 12);
+                ccsds_count++;
+            }),
+        on<protocol_id_t::SPW_PROTO_ID_STUP>(
+            [&](const raw_packet_view& p)
+            {
+                REQUIRE(p.size() == 5);
+                stup_count++;
+            }),
+        otherwise([&](const raw_packet_view&) { other_count++; }));
+
+    GIVEN("mixed traffic")
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            dispatcher(rmap_packet.data(), rmap_packet.size());
+            dispatcher(ccsds_packet.data(), ccsds_packet.size());
+            dispatcher(stup_packet.data(), stup_packet.size());
+            dispatcher(goes_packet.data(), goes_packet.size());
+        }
+        dispatcher(stup_packet.data(), 1);
+        THEN("each packet reaches its handler")
+        {
+            REQUIRE(rmap_count == 3);
+            REQUIRE(ccsds_count == 3);
+            REQUIRE(stup_count == 3);
+            REQUIRE(other_count == 4);
+        }
+    }
+    GIVEN("decoded RMAP packets")
+    {
+        const rmap::packet_view rmap_view { rmap_packet.data(), rmap_packet.size() };
+        const rmap::packet_view ccsds_view { ccsds_packet.data(), ccsds_packet.size() };
+        dispatcher(rmap_view);
+        dispatcher(ccsds_view);
+        REQUIRE(rmap_count == 1);
+        REQUIRE(ccsds_count == 1);
+    }
+    GIVEN("a dispatcher without fallback")
+    {
+        auto rmap_only = make_dispatcher(
+            on<protocol_id_t::SPW_PROTO_ID_RMAP>([&](const rmap::packet_view&) { rmap_count++; }));
+        rmap_only(ccsds_packet.data(), ccsds_packet.size());
+        rmap_only(rmap_packet.data(), rmap_packet.size());
+        REQUIRE(rmap_count == 1);
+    }
+}
@@ -0,0 +1,184 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/timestamped_link.hpp>
+#include <SpaceWirePP/unix_socket_link.hpp>
+#include <array>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+SCENARIO("Time-codes", "[]")
+{
+    using spacewire::time_code;
+    GIVEN("a time-code with control flags")
+    {
+        const auto code = time_code::make(63, 2);
+        THEN("time and flags are packed in one byte")
+        {
+            REQUIRE(code.time() == 63);
+            REQUIRE(code.flags() == 2);
+            REQUIRE(code.value == 0xBF);
+        }
+        THEN("the time counter wraps around, keeping the flags")
+        {
+            REQUIRE(code.next() == time_code::make(0, 2));
+            REQUIRE(code.distance_to(time_code::make(1)) == 2);
+            REQUIRE(time_code::make(1).distance_to(code) == 62);
+        }
+    }
+}
+
+SCENARIO("Timestamp clock", "[]")
+{
+    using spacewire::timestamp_clock;
+    GIVEN("two timestamps around a sleep")
+    {
+        const auto ns_before = spacewire::details::timestamp::monotonic_raw_ns();
+        const auto before = timestamp_clock::now();
+        std::this_thread::sleep_for(20ms);
+        const auto after = timestamp_clock::now();
+        const auto ns_after = spacewire::details::timestamp::monotonic_raw_ns();
+        THEN("timestamps are monotonic")
+        {
+            REQUIRE(after > before);
+        }
+        THEN("elapsed time matches CLOCK_MONOTONIC_RAW")
+        {
+            const auto elapsed = timestamp_clock::elapsed(before, after).count();
+            const auto reference = static_cast<int64_t>(ns_after - ns_before);
+            REQUIRE(elapsed >= 20'000'000 * 99 / 100);
+            REQUIRE(elapsed <= reference + reference / 100);
+        }
+    }
+}
+
+SCENARIO("Event channel", "[]")
+{
+    using namespace spacewire;
+    GIVEN("a full event channel")
+    {
+        event_channel events { 4 };
+        for (unsigned char i = 0; i < 4; i++)
+            REQUIRE(events.publish(
+                link_event::time_code_event(event_kind::time_code_received, i, time_code { i })));
+        WHEN("more events are published")
+        {
+            REQUIRE_FALSE(events.publish(link_event::state_event(4, link_state::run)));
+            THEN("they are dropped and counted")
+            {
+                REQUIRE(events.dropped() == 1);
+                std::vector<unsigned char> codes;
+                const auto drained = events.drain(
+                    [&codes](const link_event& e) { codes.push_back(e.code.value); });
+                REQUIRE(drained == 4);
+                REQUIRE(codes == std::vector<unsigned char> { 0, 1, 2, 3 });
+                REQUIRE_FALSE(events.poll());
+            }
+        }
+    }
+}
+
+SCENARIO("Timestamped link", "[]")
+{
+    using namespace spacewire;
+    GIVEN("a timestamped loopback link pair")
+    {
+        auto links = loopback_link::make_pair();
+        event_channel a_events, b_events;
+        timestamped_link a { links.first, a_events };
+        timestamped_link b { links.second, b_events };
+        const std::vector<unsigned char> packet { 0xFE, 1, 0, 0x4C, 0x20, 0, 0, 1, 0xAA, 0xBB };
+        WHEN("a packet goes across")
+        {
+            const auto before = timestamp_clock::now();
+            const std::array<const_buffer, 2> pieces { const_buffer { packet.data(), 3 },
+                const_buffer { packet.data() + 3, std::size(packet) - 3 } };
+            REQUIRE(a.send(pieces.data(), std::size(pieces)));
+            std::array<unsigned char, 64> buffer;
+            REQUIRE(b.receive(buffer.data(), std::size(buffer), 100ms) == std::size(packet));
+            const auto after = timestamp_clock::now();
+            THEN("both ends publish it with its size and head, in time order")
+            {
+                const auto sent = a_events.poll();
+                const auto received = b_events.poll();
+                REQUIRE(sent);
+                REQUIRE(received);
+                REQUIRE(sent->kind == event_kind::packet_sent);
+                REQUIRE(received->kind == event_kind::packet_received);
+                for (const auto& e : { *sent, *received })
+                {
+                    REQUIRE(e.size == std::size(packet));
+                    REQUIRE(std::equal(std::begin(e.head), std::end(e.head), packet.data()));
+                }
+                REQUIRE(before <= sent->timestamp);
+                REQUIRE(sent->timestamp <= received->timestamp);
+                REQUIRE(received->timestamp <= after);
+            }
+        }
+        WHEN("a packet is scattered")
+        {
+            REQUIRE(a.send(packet.data(), 4));
+            std::array<unsigned char, 2> header;
+            std::array<unsigned char, 16> payload;
+            const std::array<mutable_buffer, 2> pieces { mutable_buffer { header.data(), 2 },
+                mutable_buffer { payload.data(), std::size(payload) } };
+            REQUIRE(b.receive_scatter(pieces.data(), std::size(pieces), 100ms) == 4);
+            THEN("only received bytes make its head")
+            {
+                const auto received = b_events.poll();
+                REQUIRE(received);
+                REQUIRE(received->size == 4);
+                REQUIRE(std::equal(packet.data(), packet.data() + 4, std::begin(received->head)));
+                REQUIRE(received->head[4] == 0);
+            }
+        }
+        WHEN("a time-code is sent")
+        {
+            REQUIRE(a.send_time_code(time_code::make(42)));
+            THEN("it is published as sent then received by the peer")
+            {
+                const auto sent = a_events.poll();
+                const auto received = b_events.poll();
+                REQUIRE(sent);
+                REQUIRE(received);
+                REQUIRE(sent->kind == event_kind::time_code_sent);
+                REQUIRE(received->kind == event_kind::time_code_received);
+                REQUIRE(received->code == time_code::make(42));
+                REQUIRE(sent->timestamp <= received->timestamp);
+            }
+        }
+        WHEN("the link is closed")
+        {
+            links.first.close();
+            THEN("both ends publish a reset")
+            {
+                for (auto* events : { &a_events, &b_events })
+                {
+                    const auto e = events->poll();
+                    REQUIRE(e);
+                    REQUIRE(e->kind == event_kind::state_changed);
+                    REQUIRE(e->state == link_state::error_reset);
+                    REQUIRE_FALSE(events->poll());
+                }
+                REQUIRE_FALSE(a.send_time_code(time_code {}));
+            }
+        }
+    }
+    GIVEN("a UNIX socket link")
+    {
+        auto links = unix_socket_link::make_pair();
+        THEN("it cannot carry time-codes")
+        {
+            REQUIRE_FALSE(links.first.send_time_code(spacewire::time_code {}));
+        }
+    }
+}
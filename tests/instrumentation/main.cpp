@@ -0,0 +1,157 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+// this test always builds with instrumentation, whatever with_instrumentation says
+#ifndef SPACEWIREPP_INSTRUMENTATION
+#define SPACEWIREPP_INSTRUMENTATION 1
+#endif
+#include <SpaceWirePP/client.hpp>
+#include <SpaceWirePP/instrumentation.hpp>
+#include <SpaceWirePP/packet_view.hpp>
+#include <SpaceWirePP/target.hpp>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+SCENARIO("Latency histogram", "[]")
+{
+    using spacewire::instrumentation::latency_histogram;
+    GIVEN("the bucket layout")
+    {
+        THEN("every value falls in a bucket covering it with a bounded relative error")
+        {
+            for (uint64_t value = 0; value < (uint64_t { 1 } << 40); value = value * 5 / 4 + 1)
+            {
+                const auto index = latency_histogram::bucket_index(value);
+                REQUIRE(index < latency_histogram::bucket_count);
+                REQUIRE(latency_histogram::bucket_lowest_value(index) <= value);
+                REQUIRE(latency_histogram::bucket_highest_value(index) >= value);
+                REQUIRE(latency_histogram::bucket_highest_value(index)
+                        - latency_histogram::bucket_lowest_value(index)
+                    <= value / 32);
+            }
+            REQUIRE(latency_histogram::bucket_index(uint64_t { 1 } << 50)
+                == latency_histogram::bucket_count - 1);
+        }
+    }
+    GIVEN("a histogram of 1 to 1000")
+    {
+        latency_histogram h;
+        for (uint64_t value = 1; value <= 1000; value++)
+            h.record(value);
+        REQUIRE(h.count() == 1000);
+        REQUIRE(h.min() == 1);
+        REQUIRE(h.max() == 1000);
+        REQUIRE(h.mean() == Approx(500.5));
+        REQUIRE(h.value_at_percentile(50) == Approx(500).epsilon(0.04));
+        REQUIRE(h.value_at_percentile(99) == Approx(990).epsilon(0.04));
+        REQUIRE(h.value_at_percentile(100) == 1000);
+        latency_histogram other;
+        other.record(5000);
+        h.merge(other);
+        REQUIRE(h.count() == 1001);
+        REQUIRE(h.max() == 5000);
+    }
+}
+
+SCENARIO("Hot path counters", "[]")
+{
+    using namespace spacewire;
+    using namespace spacewire::rmap;
+    using instrumentation::counter;
+    REQUIRE(instrumentation::enabled);
+    GIVEN("built and parsed packets")
+    {
+        const auto before = instrumentation::take_snapshot();
+        std::vector<unsigned char> data(100, 0x5A);
+        std::vector<unsigned char> packet(write_request_buffer_size(data.size()));
+        const auto size
+            = *build_write_request(0xFE, 0, 0x67, 0x1000, 1, data.data(), data.size(), packet);
+        packet_view { packet.data(), size };
+        packet.back() ^= 0xFF;
+        packet_view { packet.data(), size };
+        packet[15] ^= 0xFF;
+        packet_view { packet.data(), size };
+        std::array<unsigned char, 8> reply;
+        build_write_reply(0x67, write_packet_type(), status_t::invalid_key, 0xFE, 1, reply.data());
+        packet_view { reply.data(), reply.size() };
+        const auto after = instrumentation::take_snapshot();
+        THEN("counters account for them")
+        {
+            REQUIRE(after[counter::packets_built] - before[counter::packets_built] == 2);
+            REQUIRE(after[counter::bytes_built] - before[counter::bytes_built] == size + 8);
+            REQUIRE(after[counter::packets_parsed] - before[counter::packets_parsed] == 4);
+            REQUIRE(after[counter::bytes_parsed] - before[counter::bytes_parsed] == 3 * size + 8);
+            REQUIRE(after[counter::data_crc_errors] - before[counter::data_crc_errors] == 1);
+            REQUIRE(after[counter::header_crc_errors] - before[counter::header_crc_errors] == 1);
+            const auto status = static_cast<std::size_t>(status_t::invalid_key);
+            REQUIRE(after.statuses[status] - before.statuses[status] == 1);
+        }
+    }
+    GIVEN("several threads")
+    {
+        const auto before = instrumentation::take_snapshot();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+            threads.emplace_back(
+                []()
+                {
+                    std::array<unsigned char, read_request_buffer_size()> packet;
+                    for (int i = 0; i < 1000; i++)
+                        build_read_request(0xFE, 0, 0x67, 0, i, 4, packet);
+                });
+        for (auto& thread : threads)
+            thread.join();
+        const auto after = instrumentation::take_snapshot();
+        THEN("their shards are merged")
+        {
+            REQUIRE(after[counter::packets_built] - before[counter::packets_built] == 4000);
+            REQUIRE(after[counter::bytes_built] - before[counter::bytes_built] == 4000 * 16);
+        }
+    }
+    GIVEN("a client talking to a target")
+    {
+        auto links = loopback_link::make_pair();
+        std::vector<unsigned char> memory(4096);
+        target t { 0xFE, 0 };
+        t.map_memory(0, memory.data(), memory.size());
+        std::thread serving { [&]() { t.serve(links.second); } };
+        const auto before = instrumentation::take_snapshot();
+        {
+            client c { links.first, client_config { 0xFE, 0, 0x67, 8, 1000ms, 5ms, 1 << 16 } };
+            for (int i = 0; i < 20; i++)
+                REQUIRE(c.read(0, 64).get().ok());
+        }
+        const auto after = instrumentation::take_snapshot();
+        links.first.close();
+        serving.join();
+        THEN("round trips are recorded")
+        {
+            REQUIRE(after[counter::round_trips] - before[counter::round_trips] == 20);
+            REQUIRE(after.round_trip.count() - before.round_trip.count() == 20);
+            REQUIRE(after.round_trip.max() > 0);
+            REQUIRE(after.statuses[0] - before.statuses[0] == 20);
+        }
+        THEN("snapshots can be exported")
+        {
+            const auto text = instrumentation::to_text(after);
+            REQUIRE(text.find("packets_built ") != std::string::npos);
+            REQUIRE(text.find("round_trip_ns count=") != std::string::npos);
+            const auto json = instrumentation::to_json(after);
+            REQUIRE(json.front() == '{');
+            REQUIRE(json.back() == '}');
+            REQUIRE(json.find("\"round_trips\":") != std::string::npos);
+            REQUIRE(json.find("\"p99\":") != std::string::npos);
+            REQUIRE(json.find("\"statuses\":{\"0\":") != std::string::npos);
+        }
+    }
+}
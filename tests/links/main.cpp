@@ -0,0 +1,197 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/udp_link.hpp>
+#include <SpaceWirePP/unix_socket_link.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+std::vector<unsigned char> make_packet(std::size_t index)
+{
+    std::vector<unsigned char> packet(1 + index % 97);
+    for (std::size_t i = 0; i < std::size(packet); i++)
+        packet[i] = static_cast<unsigned char>(index + i);
+    return packet;
+}
+
+void disconnect(spacewire::loopback_link& link)
+{
+    link.close();
+}
+
+void disconnect(spacewire::socket_link& link)
+{
+    link.shutdown();
+}
+
+template <typename link_t>
+void check_link(link_t& a, link_t& b)
+{
+    constexpr std::size_t count = 200;
+    std::vector<std::vector<unsigned char>> packets;
+    std::vector<spacewire::const_buffer> buffers;
+    for (std::size_t i = 0; i < count; i++)
+        packets.push_back(make_packet(i));
+    for (const auto& packet : packets)
+        buffers.push_back({ packet.data(), std::size(packet) });
+    WHEN("nothing is sent")
+    {
+        std::array<unsigned char, 16> buffer;
+        const spacewire::mutable_buffer out { buffer.data(), buffer.size() };
+        std::size_t size;
+        THEN("batched receive times out")
+        {
+            REQUIRE(b.receive_packets(&out, &size, 1, 1ms) == 0);
+        }
+        THEN("lease times out with an empty lease")
+        {
+            auto lease = b.lease(1ms);
+            REQUIRE(lease);
+            REQUIRE_FALSE(*lease);
+        }
+    }
+    WHEN("a batch is sent")
+    {
+        REQUIRE(a.send_packets(buffers.data(), count) == count);
+        THEN("batched receive gets every packet in order")
+        {
+            std::vector<std::array<unsigned char, 128>> storage(16);
+            std::vector<spacewire::mutable_buffer> out;
+            for (auto& s : storage)
+                out.push_back({ s.data(), s.size() });
+            std::array<std::size_t, 16> sizes;
+            std::size_t received = 0;
+            while (received < count)
+            {
+                const auto n = b.receive_packets(out.data(), sizes.data(), out.size(), 100ms);
+                REQUIRE(n);
+                REQUIRE(*n > 0);
+                REQUIRE(*n <= out.size());
+                for (std::size_t i = 0; i < *n; i++, received++)
+                {
+                    REQUIRE(sizes[i] == std::size(packets[received]));
+                    REQUIRE(std::equal(std::cbegin(packets[received]),
+                        std::cend(packets[received]), storage[i].data()));
+                }
+            }
+            REQUIRE(received == count);
+        }
+        THEN("truncated packets report their full size")
+        {
+            std::array<unsigned char, 4> small;
+            const spacewire::mutable_buffer out { small.data(), small.size() };
+            std::size_t size = 0;
+            for (std::size_t i = 0; i < 10; i++)
+            {
+                REQUIRE(b.receive_packets(&out, &size, 1, 100ms) == 1);
+                REQUIRE(size == std::size(packets[i]));
+            }
+        }
+        THEN("leases lend every packet")
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                auto lease = b.lease(100ms);
+                REQUIRE(lease);
+                REQUIRE(*lease);
+                REQUIRE(lease->size() == std::size(packets[i]));
+                REQUIRE(std::equal(
+                    std::cbegin(packets[i]), std::cend(packets[i]), lease->data()));
+            }
+        }
+    }
+    WHEN("a packet is peeked at then scattered")
+    {
+        REQUIRE(a.can_peek());
+        REQUIRE(a.send(packets[20].data(), std::size(packets[20])));
+        std::array<unsigned char, 4> head;
+        std::array<unsigned char, 16> body;
+        std::array<unsigned char, 1> tail;
+        THEN("peeking leaves the packet pending")
+        {
+            REQUIRE(b.peek(head.data(), head.size(), 100ms) == std::size(packets[20]));
+            REQUIRE(b.peek(head.data(), head.size(), 0ms) == std::size(packets[20]));
+            REQUIRE(std::equal(std::cbegin(head), std::cend(head), packets[20].data()));
+            const spacewire::mutable_buffer pieces[] { { head.data(), head.size() },
+                { body.data(), body.size() }, { tail.data(), tail.size() } };
+            REQUIRE(b.receive_scatter(pieces, 3, 0ms) == std::size(packets[20]));
+            REQUIRE(std::equal(std::cbegin(body), std::cend(body), packets[20].data() + 4));
+            REQUIRE(tail[0] == packets[20][20]);
+            REQUIRE(b.peek(head.data(), head.size(), 1ms) == 0);
+        }
+    }
+    WHEN("the link is disconnected")
+    {
+        disconnect(b);
+        std::array<unsigned char, 16> buffer;
+        const spacewire::mutable_buffer out { buffer.data(), buffer.size() };
+        std::size_t size;
+        THEN("batched receive reports it")
+        {
+            REQUIRE_FALSE(b.receive_packets(&out, &size, 1, 100ms));
+        }
+    }
+}
+}
+
+SCENARIO("Link backends", "[]")
+{
+    GIVEN("a loopback link")
+    {
+        auto links = spacewire::loopback_link::make_pair();
+        check_link(links.first, links.second);
+        WHEN("several packets are leased at once")
+        {
+            const std::array<unsigned char, 3> packet { 1, 2, 3 };
+            for (int i = 0; i < 3; i++)
+                links.first.send(packet.data(), packet.size());
+            auto first = links.second.lease(10ms);
+            auto second = links.second.lease(10ms);
+            THEN("each lease keeps its own packet")
+            {
+                REQUIRE(*first);
+                REQUIRE(*second);
+                REQUIRE(first->data() != second->data());
+                first->release();
+                REQUIRE_FALSE(*first);
+                REQUIRE(std::equal(std::cbegin(packet), std::cend(packet), second->data()));
+                auto third = links.second.lease(10ms);
+                REQUIRE(*third);
+                *second = std::move(*third);
+                REQUIRE_FALSE(*third);
+                REQUIRE(second->size() == 3);
+            }
+        }
+    }
+    GIVEN("a UNIX socket link")
+    {
+        auto links = spacewire::unix_socket_link::make_pair();
+        REQUIRE(links.first.is_open());
+        check_link(links.first, links.second);
+    }
+    GIVEN("a UDP link")
+    {
+        auto links = spacewire::udp_link::make_pair(1 << 20);
+        REQUIRE(links.first.is_open());
+        REQUIRE(links.first.port() != 0);
+        check_link(links.first, links.second);
+        WHEN("opened from addresses")
+        {
+            auto a = spacewire::udp_link::open("127.0.0.1", 0, "127.0.0.1", links.first.port());
+            REQUIRE(a.is_open());
+            REQUIRE_FALSE(spacewire::udp_link::open("not an address", 0, "127.0.0.1", 1).is_open());
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/packet_pool.hpp>
+#include <SpaceWirePP/rmap.hpp>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+
+SCENARIO("Packet pool", "[]")
+{
+    using namespace spacewire;
+    GIVEN("A pool of 4 slots")
+    {
+        packet_pool pool { rmap::read_request_buffer_size(), 4 };
+        THEN("slots are cache line aligned and distinct")
+        {
+            std::vector<packet_pool::handle> handles;
+            std::set<unsigned char*> slots;
+            for (int i = 0; i < 4; i++)
+            {
+                handles.push_back(pool.acquire());
+                REQUIRE(handles.back());
+                REQUIRE(reinterpret_cast<std::uintptr_t>(handles.back().data())
+                        % packet_pool::alignment
+                    == 0);
+                slots.insert(handles.back().data());
+            }
+            REQUIRE(slots.size() == 4);
+            AND_THEN("the pool is exhausted") { REQUIRE_FALSE(pool.acquire()); }
+            AND_THEN("releasing a handle makes its slot available again")
+            {
+                handles.pop_back();
+                REQUIRE(pool.acquire());
+            }
+        }
+        THEN("handles can be used as builder output")
+        {
+            auto packet = pool.acquire();
+            auto size = rmap::build_read_request(254, 2, 32, 0x80000000, 0x1234, 32, packet);
+            REQUIRE(size == rmap::read_request_buffer_size());
+            REQUIRE(rmap::header_crc_valid<rmap::rmap_read_cmd_tag>(packet.data()));
+        }
+    }
+    GIVEN("A pool shared between threads")
+    {
+        packet_pool pool { 64, 8 };
+        std::atomic<int> in_use { 0 };
+        std::atomic<bool> overflow { false };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+            threads.emplace_back(
+                [&]()
+                {
+                    for (int i = 0; i < 10000; i++)
+                    {
+                        if (auto packet = pool.acquire(); packet)
+                        {
+                            if (++in_use > 8)
+                                overflow = true;
+                            packet.data()[0] = static_cast<unsigned char>(i);
+                            --in_use;
+                        }
+                    }
+                });
+        for (auto& thread : threads)
+            thread.join();
+        REQUIRE_FALSE(overflow);
+        THEN("every slot is back in the pool")
+        {
+            std::vector<packet_pool::handle> handles;
+            for (int i = 0; i < 8; i++)
+                handles.push_back(pool.acquire());
+            REQUIRE(std::all_of(std::cbegin(handles), std::cend(handles),
+                [](const auto& h) { return static_cast<bool>(h); }));
+        }
+    }
+}
@@ -0,0 +1,212 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/packet_view.hpp>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+std::vector<unsigned char> read_reply(uint16_t tid, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> packet { 0x67, 0x01, 0b00001100, 0x00, 0xFE,
+        static_cast<unsigned char>(tid >> 8), static_cast<unsigned char>(tid), 0x00, 0x00,
+        static_cast<unsigned char>(data.size() >> 8), static_cast<unsigned char>(data.size()) };
+    packet.push_back(spacewire::crc(packet.data(), packet.size()));
+    packet.insert(std::end(packet), std::cbegin(data), std::cend(data));
+    packet.push_back(spacewire::crc(data.data(), data.size()));
+    return packet;
+}
+
+std::vector<unsigned char> write_reply(uint16_t tid, spacewire::rmap::status_t status)
+{
+    std::vector<unsigned char> packet { 0x67, 0x01, 0b00101100,
+        static_cast<unsigned char>(status), 0xFE, static_cast<unsigned char>(tid >> 8),
+        static_cast<unsigned char>(tid) };
+    packet.push_back(spacewire::crc(packet.data(), packet.size()));
+    return packet;
+}
+}
+
+SCENARIO("RMAP packet view", "[]")
+{
+    using namespace spacewire::rmap;
+    GIVEN("a read command")
+    {
+        std::vector<unsigned char> packet(read_request_buffer_size());
+        build_read_request(254, 2, 32, 0x80000000, 0x1234, 32, packet);
+        packet_view view { packet.data(), packet.size() };
+        REQUIRE(view.valid());
+        REQUIRE(view.kind() == packet_kind::read_command);
+        REQUIRE(view.destination_logical_address() == 254);
+        REQUIRE(view.key() == 2);
+        REQUIRE(view.source_logical_address() == 32);
+        REQUIRE(view.address() == 0x80000000);
+        REQUIRE(view.transaction_id() == 0x1234);
+        REQUIRE(view.data_length() == 32);
+        REQUIRE(view.acknowledge());
+        REQUIRE(view.increment());
+        REQUIRE_FALSE(view.verify());
+        WHEN("a byte is corrupted")
+        {
+            packet[9] ^= 0x10;
+            THEN("header CRC check fails")
+            {
+                packet_view corrupted { packet.data(), packet.size() };
+                REQUIRE(corrupted.kind() == packet_kind::read_command);
+                REQUIRE(corrupted.error() == packet_error::header_crc);
+            }
+        }
+    }
+    GIVEN("a write command")
+    {
+        std::vector<unsigned char> data(300);
+        std::iota(std::begin(data), std::end(data), 0);
+        std::vector<unsigned char> packet(write_request_buffer_size(data.size()));
+        build_write_request(254, 2, 32, 0x1000, 7, data.data(), data.size(), packet);
+        packet_view view { packet.data(), packet.size() };
+        REQUIRE(view.valid());
+        REQUIRE(view.kind() == packet_kind::write_command);
+        REQUIRE(view.data_length() == data.size());
+        REQUIRE(std::vector(view.data(), view.data() + view.data_length()) == data);
+        WHEN("a data byte is corrupted")
+        {
+            packet[100] ^= 1;
+            packet_view corrupted { packet.data(), packet.size() };
+            REQUIRE(corrupted.header_crc_valid());
+            REQUIRE(corrupted.error() == packet_error::data_crc);
+        }
+        WHEN("the packet is longer than expected")
+        {
+            packet.push_back(0);
+            REQUIRE(packet_view { packet.data(), packet.size() }.error()
+                == packet_error::too_much_data);
+        }
+        THEN("every truncated packet is rejected")
+        {
+            for (std::size_t size = 0; size < packet.size(); size++)
+            {
+                std::vector<unsigned char> truncated(
+                    std::cbegin(packet), std::cbegin(packet) + size);
+                packet_view view { truncated.data(), truncated.size() };
+                REQUIRE_FALSE(view.valid());
+                REQUIRE((view.error() == packet_error::too_short
+                    || view.error() == packet_error::early_eop));
+            }
+        }
+    }
+    GIVEN("replies")
+    {
+        const auto read = read_reply(42, { 1, 2, 3, 4 });
+        packet_view read_view { read.data(), read.size() };
+        REQUIRE(read_view.valid());
+        REQUIRE(read_view.kind() == packet_kind::read_reply);
+        REQUIRE(read_view.status() == status_t::success);
+        REQUIRE(read_view.transaction_id() == 42);
+        REQUIRE(read_view.data_length() == 4);
+        REQUIRE(read_view.data()[3] == 4);
+        REQUIRE(is_rmap_read_response(read.data()));
+        REQUIRE(header_crc_valid<rmap_read_response_tag>(read.data()));
+
+        WHEN("the data CRC is deferred")
+        {
+            auto corrupted = read;
+            corrupted[13] ^= 1;
+            const packet_view deferred { corrupted.data(), corrupted.size(),
+                packet_view::deferred_data_crc };
+            std::array<unsigned char, 4> destination {};
+            THEN("the data CRC is checked while copying the data")
+            {
+                REQUIRE(deferred.valid());
+                REQUIRE(deferred.data_crc_deferred());
+                REQUIRE_FALSE(deferred.check_data_crc());
+                REQUIRE_FALSE(deferred.copy_data(destination.data()));
+                REQUIRE(destination[1] == (2 ^ 1));
+                REQUIRE(packet_view { read.data(), read.size(), packet_view::deferred_data_crc }
+                            .copy_data(destination.data()));
+                REQUIRE(destination == std::array<unsigned char, 4> { 1, 2, 3, 4 });
+            }
+        }
+        WHEN("the data was received apart from the header")
+        {
+            const packet_view placed { read.data(), 12, read.data() + 12, 4, read[16] };
+            THEN("it is validated in place")
+            {
+                REQUIRE(placed.valid());
+                REQUIRE(placed.data() == read.data() + 12);
+                REQUIRE(placed.size() == read.size());
+                REQUIRE_FALSE(packet_view { read.data(), 12, read.data() + 12, 4,
+                    static_cast<unsigned char>(read[16] + 1) }
+                                  .valid());
+                REQUIRE(packet_view { read.data(), 12, read.data() + 12, 3, read[16] }.error()
+                    == packet_error::early_eop);
+                REQUIRE(packet_view { read.data(), 13, read.data() + 12, 4, read[16] }.error()
+                    == packet_error::too_much_data);
+            }
+        }
+
+        const auto write = write_reply(43, status_t::invalid_key);
+        packet_view write_view { write.data(), write.size() };
+        REQUIRE(write_view.valid());
+        REQUIRE(write_view.kind() == packet_kind::write_reply);
+        REQUIRE(write_view.status() == status_t::invalid_key);
+        REQUIRE(write_view.source_logical_address() == 0xFE);
+        REQUIRE(write_view.transaction_id() == 43);
+        REQUIRE(is_rmap_write_response(write.data()));
+        REQUIRE(header_crc_valid<rmap_write_response_tag>(write.data()));
+    }
+    GIVEN("non RMAP packets")
+    {
+        const unsigned char ccsds[] { 0x20, 0x02, 0x00, 0x00, 0x08, 0x00, 0xC0, 0x00, 0x00 };
+        REQUIRE(packet_view { ccsds, sizeof(ccsds) }.error() == packet_error::not_rmap);
+        const unsigned char bad_type[] { 0x20, 0x01, 0b01000000, 0x00, 0x00, 0x00, 0x00, 0x00 };
+        REQUIRE(packet_view { bad_type, sizeof(bad_type) }.error()
+            == packet_error::invalid_packet_type);
+    }
+}
+
+SCENARIO("RMAP packet type classification", "[]")
+{
+    using namespace spacewire::rmap;
+    for (unsigned int reply_address_length = 0; reply_address_length < 4; reply_address_length++)
+    {
+        const auto type = [=](unsigned int command_bits)
+        { return static_cast<unsigned char>(command_bits << 2 | reply_address_length); };
+        for (unsigned int command = 0; command < 16; command++)
+        {
+            const auto command_kind = classify_packet_type(0b01000000 | type(command));
+            const auto reply_kind = classify_packet_type(type(command));
+            if (command & 0b1000)
+            {
+                REQUIRE(command_kind == packet_kind::write_command);
+                REQUIRE(reply_kind
+                    == ((command & 0b0010) ? packet_kind::write_reply : packet_kind::invalid));
+            }
+            else if (command == 0b0010 || command == 0b0011)
+            {
+                REQUIRE(command_kind == packet_kind::read_command);
+                REQUIRE(reply_kind == packet_kind::read_reply);
+            }
+            else if (command == 0b0111)
+            {
+                REQUIRE(command_kind == packet_kind::rmw_command);
+                REQUIRE(reply_kind == packet_kind::rmw_reply);
+            }
+            else
+            {
+                REQUIRE(command_kind == packet_kind::invalid);
+                REQUIRE(reply_kind == packet_kind::invalid);
+            }
+            REQUIRE(classify_packet_type(0b10000000 | type(command)) == packet_kind::invalid);
+        }
+    }
+}
@@ -0,0 +1,209 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/pipeline.hpp>
+#include <SpaceWirePP/ring.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+SCENARIO("Bounded ring", "[]")
+{
+    using namespace spacewire;
+    GIVEN("a ring")
+    {
+        bounded_ring<int> ring { 5 };
+        REQUIRE(ring.capacity() == 8);
+        REQUIRE(ring.empty());
+        THEN("it is FIFO and bounded")
+        {
+            for (int i = 0; i < 8; i++)
+                REQUIRE(ring.try_push(i));
+            REQUIRE_FALSE(ring.try_push(8));
+            for (int i = 0; i < 8; i++)
+                REQUIRE(*ring.try_pop() == i);
+            REQUIRE_FALSE(ring.try_pop());
+        }
+        THEN("concurrent producers and consumers see every value once")
+        {
+            const int per_producer = 20000;
+            std::atomic<long long> sum { 0 };
+            std::atomic<int> popped { 0 };
+            std::vector<std::thread> threads;
+            for (int p = 0; p < 2; p++)
+                threads.emplace_back(
+                    [&ring, p]()
+                    {
+                        for (int i = 0; i < per_producer; i++)
+                            while (!ring.try_push(p * per_producer + i))
+                                std::this_thread::yield();
+                    });
+            for (int c = 0; c < 2; c++)
+                threads.emplace_back(
+                    [&]()
+                    {
+                        while (popped.load() < 2 * per_producer)
+                        {
+                            if (auto value = ring.try_pop(); value)
+                            {
+                                sum += *value;
+                                popped++;
+                            }
+                            else
+                                std::this_thread::yield();
+                        }
+                    });
+            for (auto& thread : threads)
+                thread.join();
+            const long long n = 2 * per_producer;
+            REQUIRE(sum == n * (n - 1) / 2);
+        }
+    }
+}
+
+SCENARIO("Receive pipeline", "[]")
+{
+    using namespace spacewire::rmap;
+    auto links = spacewire::loopback_link::make_pair();
+    auto& local = links.first;
+    auto& remote = links.second;
+    std::vector<unsigned char> data(1000);
+    std::iota(std::begin(data), std::end(data), 0);
+    const std::size_t count = 2000;
+    std::vector<unsigned char> packet(read_reply_buffer_size(data.size()));
+    const auto send_replies = [&]()
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto size = build_read_reply(0x67, 0b00001100, status_t::success, 0xFE,
+                static_cast<uint16_t>(i), data.data(), static_cast<uint32_t>(data.size()),
+                packet.data());
+            if (i % 7 == 3)
+                packet[size - 1] ^= 0xFF;
+            remote.send(packet.data(), size);
+        }
+        std::vector<unsigned char> oversized(128, 0);
+        remote.send(oversized.data(), oversized.size());
+        remote.close();
+    };
+    GIVEN("an ordered pipeline")
+    {
+        std::vector<uint16_t> tids;
+        std::vector<bool> valid;
+        pipeline_config config;
+        config.workers = 4;
+        config.pool_size = 64;
+        config.max_packet_size = 127;
+        receive_pipeline pipeline { local,
+            [&](received_packet&& p)
+            {
+                tids.push_back(p.view.transaction_id());
+                valid.push_back(p.view.valid());
+            },
+            config };
+        REQUIRE(pipeline.workers() == 4);
+        WHEN("it is stopped while the link is open")
+        {
+            pipeline.stop();
+            REQUIRE(pipeline.drained());
+            REQUIRE(pipeline.received() == 0);
+        }
+        WHEN("packets are too large for the pool")
+        {
+            send_replies();
+            pipeline.wait();
+            THEN("they are all dropped")
+            {
+                REQUIRE(pipeline.dropped() == count + 1);
+                REQUIRE(tids.empty());
+            }
+        }
+    }
+    GIVEN("an ordered pipeline with large enough slots")
+    {
+        std::vector<uint16_t> tids;
+        std::vector<bool> valid;
+        pipeline_config config;
+        config.workers = 4;
+        config.pool_size = 64;
+        config.ring_capacity = 8;
+        config.max_packet_size = 2048;
+        receive_pipeline pipeline { local,
+            [&](received_packet&& p)
+            {
+                tids.push_back(p.view.transaction_id());
+                valid.push_back(p.view.valid());
+            },
+            config };
+        send_replies();
+        pipeline.wait();
+        THEN("packets are validated and dispatched in receive order")
+        {
+            REQUIRE(pipeline.drained());
+            REQUIRE(pipeline.dropped() == 0);
+            REQUIRE(std::size(tids) == count + 1);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                REQUIRE(tids[i] == i);
+                REQUIRE(valid[i] == (i % 7 != 3));
+            }
+            REQUIRE_FALSE(valid.back());
+        }
+    }
+    GIVEN("an unordered pipeline")
+    {
+        std::mutex mutex;
+        std::vector<uint64_t> sequences;
+        std::atomic<std::size_t> invalid { 0 };
+        pipeline_config config;
+        config.workers = 3;
+        config.ordered = false;
+        config.max_packet_size = 2048;
+        std::vector<received_packet> kept;
+        receive_pipeline pipeline { local,
+            [&](received_packet&& p)
+            {
+                if (!p.view.valid())
+                    invalid++;
+                std::lock_guard<std::mutex> lock { mutex };
+                sequences.push_back(p.sequence);
+                if (p.sequence < 10)
+                    kept.push_back(std::move(p));
+            },
+            config };
+        send_replies();
+        pipeline.wait();
+        // handles must not outlive the pipeline pool
+        std::vector<uint16_t> kept_tids;
+        for (const auto& p : kept)
+            kept_tids.push_back(p.view.transaction_id());
+        kept.clear();
+        THEN("every packet reaches the consumer once")
+        {
+            std::sort(std::begin(sequences), std::end(sequences));
+            REQUIRE(std::size(sequences) == count + 1);
+            for (std::size_t i = 0; i < std::size(sequences); i++)
+                REQUIRE(sequences[i] == i);
+            REQUIRE(invalid == (count + 3) / 7 + 1);
+        }
+        THEN("consumers can keep packets")
+        {
+            std::sort(std::begin(kept_tids), std::end(kept_tids));
+            REQUIRE(std::size(kept_tids) == 10);
+            for (std::size_t i = 0; i < std::size(kept_tids); i++)
+                REQUIRE(kept_tids[i] == i);
+        }
+    }
+}
@@ -8,8 +8,15 @@
 #include <catch_reporter_tap.hpp>
 #include <catch_reporter_teamcity.hpp>
 #endif
+#include <SpaceWirePP/packet_template.hpp>
+#include <SpaceWirePP/packet_view.hpp>
 #include <SpaceWirePP/rmap.hpp>
 #include <cstdint>
+#include <numeric>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
 
 
 SCENARIO("RMAP field extraction", "[]")
@@ -60,3 +67,307 @@ SCENARIO("RMAP read request", "[]")
             0x0, 0x0, 0x20, 0x3a }));
     REQUIRE(header_crc_valid<rmap_read_cmd_tag>(packet));
 }
+
+SCENARIO("RMAP builders with caller provided buffers", "[]")
+{
+    using namespace spacewire::rmap;
+    const unsigned char data[] { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x10, 0x11, 0x12,
+        0x13, 0x14, 0x15, 0x16, 0x17 };
+    GIVEN("a large enough buffer")
+    {
+        std::array<unsigned char, 64> buffer {};
+        THEN("read request is written in place")
+        {
+            auto size = build_read_request(254, 2, 32, 0x80000000, 0x1234, 32, buffer);
+            REQUIRE(size == read_request_buffer_size());
+            REQUIRE_THAT(std::vector(std::begin(buffer), std::begin(buffer) + *size),
+                Catch::Equals<uint8_t>({ 0xfe, 0x1, 0x4c, 0x2, 0x20, 0x12, 0x34, 0x0, 0x80, 0x0,
+                    0x0, 0x0, 0x0, 0x0, 0x20, 0x3a }));
+        }
+        THEN("write request is written in place")
+        {
+            auto size = build_write_request(
+                0xFE, 0, 0x67, 0xA0000000, 0, data, sizeof(data), std::data(buffer), 64);
+            REQUIRE(size == write_request_buffer_size(sizeof(data)));
+            REQUIRE(fields::header_crc<rmap_write_cmd_tag>(buffer.data()) == 0x9F);
+            REQUIRE(fields::data_crc<rmap_write_cmd_tag>(buffer.data()) == 0x56);
+            REQUIRE(data_crc_valid<rmap_write_cmd_tag>(buffer.data()));
+        }
+    }
+    GIVEN("a too small buffer")
+    {
+        std::vector<unsigned char> buffer(write_request_buffer_size(sizeof(data)) - 1);
+        THEN("builders fail without writing")
+        {
+            REQUIRE_FALSE(build_write_request(0xFE, 0, 0x67, 0, 0, data, sizeof(data), buffer));
+            REQUIRE(std::all_of(
+                std::cbegin(buffer), std::cend(buffer), [](auto v) { return v == 0; }));
+            REQUIRE_FALSE(build_read_request(0xFE, 0, 0x67, 0, 0, 4, buffer.data(), 15));
+            REQUIRE_FALSE(build_read_request(0xFE, 0, 0x67, 0, 0, 1 << 24, buffer));
+        }
+    }
+}
+
+SCENARIO("RMAP scatter-gather write request", "[]")
+{
+    using namespace spacewire::rmap;
+    std::vector<unsigned char> data(4096);
+    std::iota(std::begin(data), std::end(data), 0);
+    std::vector<unsigned char> expected(write_request_buffer_size(std::size(data)));
+    build_write_request(
+        0xFE, 2, 0x67, 0x40001000, 0xBEEF, data.data(), std::size(data), expected.data());
+    auto segments = build_write_request_segments(
+        0xFE, 2, 0x67, 0x40001000, 0xBEEF, data.data(), std::size(data));
+    REQUIRE(segments.payload == data.data());
+    REQUIRE(segments.size() == std::size(expected));
+    THEN("its concatenation is identical to build_write_request output")
+    {
+        std::vector<unsigned char> packet(segments.size());
+        segments.copy_to(packet.data());
+        REQUIRE(packet == expected);
+    }
+#if __has_include(<sys/uio.h>)
+    THEN("it can be sent with writev")
+    {
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        const auto iov = segments.iovecs();
+        REQUIRE(writev(fds[1], std::data(iov), std::size(iov))
+            == static_cast<ssize_t>(segments.size()));
+        std::vector<unsigned char> packet(segments.size());
+        std::size_t received = 0;
+        while (received < std::size(packet))
+            received += read(fds[0], packet.data() + received, std::size(packet) - received);
+        close(fds[0]);
+        close(fds[1]);
+        REQUIRE(packet == expected);
+    }
+#endif
+}
+
+SCENARIO("RMAP packet templates", "[]")
+{
+    using namespace spacewire::rmap;
+    GIVEN("a compile time write command template")
+    {
+        static constexpr packet_template<rmap_write_cmd_tag> tmpl { 0xFE, 0, 0x67, 0xA0000000, 16 };
+        static_assert(tmpl.header()[15] == 0x9F);
+        static_assert(tmpl.packet_size() == write_request_buffer_size(16));
+        THEN("it matches the ECSS test pattern")
+        {
+            const unsigned char data[] { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x10,
+                0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17 };
+            std::array<unsigned char, write_request_buffer_size(16)> buffer {};
+            REQUIRE(tmpl.build(0, data, buffer.data()) == std::size(buffer));
+            std::array<unsigned char, write_request_buffer_size(16)> expected {};
+            build_write_request(0xFE, 0, 0x67, 0xA0000000, 0, data, 16, expected);
+            REQUIRE(buffer == expected);
+            REQUIRE(tmpl.build(0x4321, 0x1234, data, buffer.data()) == std::size(buffer));
+            build_write_request(0xFE, 0, 0x67, 0x1234, 0x4321, data, 16, expected);
+            REQUIRE(buffer == expected);
+        }
+    }
+    GIVEN("a read command template")
+    {
+        const packet_template<rmap_read_cmd_tag> tmpl { 254, 2, 32, 0x80000000, 32 };
+        THEN("patched headers match the generic builder")
+        {
+            std::array<unsigned char, read_request_buffer_size()> buffer {};
+            std::array<unsigned char, read_request_buffer_size()> expected {};
+            for (uint32_t i = 0; i < 70000; i += 7)
+            {
+                const auto tid = static_cast<uint16_t>(i * 2654435761u);
+                const uint32_t address = i * 0x9E3779B9u;
+                REQUIRE(tmpl.build(tid, buffer.data()) == read_request_buffer_size());
+                build_read_request(254, 2, 32, 0x80000000, tid, 32, expected);
+                REQUIRE(buffer == expected);
+                tmpl.build(tid, address, buffer.data());
+                build_read_request(254, 2, 32, address, tid, 32, expected);
+                REQUIRE(buffer == expected);
+            }
+        }
+    }
+}
+
+SCENARIO("RMAP routed commands", "[]")
+{
+    using namespace spacewire::rmap;
+    const unsigned char data[] { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+    GIVEN("a compile time route with path and reply path")
+    {
+        const static_route<2, 2> r { { 3, 5 }, { 7, 2 } };
+        using layout = decltype(r)::layout_type;
+        static_assert(layout::reply_address_size() == 4);
+        static_assert(layout::offset(0) == 2);
+        static_assert(layout::offset(3) == 5);
+        static_assert(layout::offset(4) == 10);
+        static_assert(layout::header_size() == 22);
+        static_assert(read_request_buffer_size(layout {}) == 22);
+        std::array<unsigned char, 64> buffer {};
+        THEN("read request starts with the path and carries the padded reply address")
+        {
+            auto size = build_read_request(r, 0xFE, 2, 0x20, 0x80000000, 0x1234, 32, buffer);
+            REQUIRE(size == 22);
+            REQUIRE_THAT(std::vector(std::begin(buffer), std::begin(buffer) + 21),
+                Catch::Equals<uint8_t>({ 0x03, 0x05, 0xfe, 0x1, 0x4d, 0x2, 0x0, 0x0, 0x7, 0x2,
+                    0x20, 0x12, 0x34, 0x0, 0x80, 0x0, 0x0, 0x0, 0x0, 0x0, 0x20 }));
+            const command_view<layout, const unsigned char> view { buffer.data() };
+            REQUIRE(view.destination_logical_address() == 0xFE);
+            REQUIRE(view.transaction_id() == 0x1234);
+            REQUIRE(view.address() == 0x80000000);
+            REQUIRE(view.header_crc_valid());
+            AND_THEN("packet view decodes it once the path is stripped")
+            {
+                packet_view decoded { buffer.data(), *size, 2 };
+                REQUIRE(decoded.valid());
+                REQUIRE(decoded.kind() == packet_kind::read_command);
+                REQUIRE(decoded.reply_address_size() == 4);
+                REQUIRE(decoded.reply_address()[3] == 0x02);
+                REQUIRE(decoded.source_logical_address() == 0x20);
+                REQUIRE(decoded.transaction_id() == 0x1234);
+            }
+        }
+        THEN("write request data follows the routed header")
+        {
+            auto size = build_write_request(
+                r, 0xFE, 0, 0x67, 0xA0000000, 3, data, sizeof(data), buffer);
+            REQUIRE(size == write_request_buffer_size(layout {}, sizeof(data)));
+            command_view<layout> view { buffer.data() };
+            REQUIRE(view.data_length() == 8);
+            REQUIRE(view.data()[7] == 0xEF);
+            REQUIRE(view.data_crc_valid());
+            view.address() = 0xA0000004;
+            REQUIRE_FALSE(view.header_crc_valid());
+        }
+        THEN("a too small buffer is rejected")
+        {
+            REQUIRE_FALSE(build_read_request(r, 0xFE, 0, 0x67, 0, 0, 4, buffer.data(), 21));
+        }
+    }
+    GIVEN("the same route only known at run time")
+    {
+        const unsigned char path[] { 3, 5 };
+        const unsigned char reply_path[] { 7, 2 };
+        const route r { path, 2, reply_path, 2 };
+        std::array<unsigned char, 64> expected {};
+        std::array<unsigned char, 64> buffer {};
+        THEN("builders produce the same packets")
+        {
+            build_write_request(static_route<2, 2> { { 3, 5 }, { 7, 2 } }, 0xFE, 0, 0x67, 0, 3,
+                data, sizeof(data), expected);
+            REQUIRE(build_write_request(r, 0xFE, 0, 0x67, 0, 3, data, sizeof(data), buffer)
+                == 31);
+            REQUIRE(buffer == expected);
+            command_view view { buffer.data(), r.layout() };
+            REQUIRE(view.source_logical_address() == 0x67);
+            REQUIRE(view.data_crc_valid());
+        }
+        THEN("an empty route matches the unrouted builders")
+        {
+            build_read_request(0xFE, 0, 0x67, 0x1000, 3, 4, expected);
+            REQUIRE(build_read_request(route {}, 0xFE, 0, 0x67, 0x1000, 3, 4, buffer) == 16);
+            REQUIRE(buffer == expected);
+        }
+    }
+}
+
+SCENARIO("RMAP command options", "[]")
+{
+    using namespace spacewire::rmap;
+    static_assert(read_packet_type() == 0b01001100);
+    static_assert(read_packet_type<options::none>() == 0b01001000);
+    static_assert(write_packet_type() == 0b01101100);
+    static_assert(write_packet_type<options::none>() == 0b01100000);
+    static_assert(write_packet_type<options::verify | options::acknowledge>() == 0b01111000);
+    static_assert(rmw_packet_type() == 0b01011100);
+    const unsigned char data[] { 0x01, 0x23, 0x45, 0x67 };
+    const unsigned char mask[] { 0xFF, 0x00, 0xF0, 0x0F };
+    std::array<unsigned char, 64> buffer {};
+    GIVEN("a non incrementing read with a 40 bits address")
+    {
+        auto size = build_read_command<options::none>(
+            0xFE, 0, 0x67, 0x12'8000'0004, 7, 64, buffer.data(), buffer.size());
+        THEN("extended address holds the upper address byte")
+        {
+            REQUIRE(size == read_request_buffer_size());
+            packet_view view { buffer.data(), *size };
+            REQUIRE(view.valid());
+            REQUIRE(view.kind() == packet_kind::read_command);
+            REQUIRE_FALSE(view.increment());
+            REQUIRE(view.extended_address() == 0x12);
+            REQUIRE(view.address() == 0x80000004);
+            REQUIRE(view.full_address() == 0x12'8000'0004);
+            REQUIRE(fields::extended_address(buffer.data()) == 0x12);
+        }
+        THEN("addresses beyond 40 bits are rejected")
+        {
+            REQUIRE_FALSE(build_read_command(
+                0xFE, 0, 0x67, uint64_t { 1 } << 40, 7, 64, buffer.data(), buffer.size()));
+        }
+    }
+    GIVEN("writes with every option combination")
+    {
+        THEN("packet types carry the requested options")
+        {
+            build_write_command<options::none>(
+                0xFE, 0, 0x67, 0x1000, 1, data, sizeof(data), buffer.data(), buffer.size());
+            packet_view no_ack { buffer.data(), write_request_buffer_size(sizeof(data)) };
+            REQUIRE(no_ack.valid());
+            REQUIRE(no_ack.kind() == packet_kind::write_command);
+            REQUIRE_FALSE(no_ack.acknowledge());
+            REQUIRE_FALSE(no_ack.verify());
+            REQUIRE_FALSE(no_ack.increment());
+
+            build_write_command<options::verify | options::acknowledge | options::increment>(
+                0xFE, 0, 0x67, 0x1000, 1, data, sizeof(data), buffer.data(), buffer.size());
+            packet_view verified { buffer.data(), write_request_buffer_size(sizeof(data)) };
+            REQUIRE(verified.valid());
+            REQUIRE(verified.verify());
+            REQUIRE(verified.acknowledge());
+            REQUIRE(verified.increment());
+        }
+        THEN("default options match the legacy builder")
+        {
+            std::array<unsigned char, 64> expected {};
+            build_write_request(0xFE, 0, 0x67, 0x1000, 1, data, sizeof(data), expected);
+            build_write_command(
+                0xFE, 0, 0x67, 0x1000, 1, data, sizeof(data), buffer.data(), buffer.size());
+            REQUIRE(buffer == expected);
+        }
+    }
+    GIVEN("a read-modify-write")
+    {
+        auto size = build_rmw_command(
+            0xFE, 0, 0x67, 0x2000, 9, data, mask, 4, buffer.data(), buffer.size());
+        THEN("it carries data followed by mask")
+        {
+            REQUIRE(size == rmw_request_buffer_size(4));
+            packet_view view { buffer.data(), *size };
+            REQUIRE(view.valid());
+            REQUIRE(view.kind() == packet_kind::rmw_command);
+            REQUIRE(view.data_length() == 8);
+            REQUIRE(view.data()[3] == 0x67);
+            REQUIRE(view.data()[4] == 0xFF);
+            REQUIRE(data_crc_valid<rmap_rmw_cmd_tag>(buffer.data()));
+        }
+        THEN("words wider than 4 bytes are rejected")
+        {
+            REQUIRE_FALSE(build_rmw_command(
+                0xFE, 0, 0x67, 0x2000, 9, data, mask, 5, buffer.data(), buffer.size()));
+        }
+        THEN("its reply is recognised")
+        {
+            const auto reply_size = build_read_reply(
+                0x67, rmw_packet_type(), status_t::success, 0xFE, 9, data, 4, buffer.data());
+            REQUIRE(reply_size == rmw_reply_buffer_size(4));
+            REQUIRE(is_rmap_rmw_response(buffer.data()));
+            REQUIRE_FALSE(is_rmap_read_response(buffer.data()));
+            REQUIRE(header_crc_valid<rmap_rmw_response_tag>(buffer.data()));
+            REQUIRE(data_crc_valid<rmap_rmw_response_tag>(buffer.data()));
+            packet_view view { buffer.data(), reply_size };
+            REQUIRE(view.valid());
+            REQUIRE(view.kind() == packet_kind::rmw_reply);
+            REQUIRE(view.data_length() == 4);
+        }
+    }
+}
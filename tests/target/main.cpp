@@ -0,0 +1,239 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/client.hpp>
+#include <SpaceWirePP/target.hpp>
+#include <SpaceWirePP/transfer.hpp>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+SCENARIO("RMAP target", "[]")
+{
+    using namespace spacewire::rmap;
+    std::vector<unsigned char> memory(4096);
+    std::iota(std::begin(memory), std::end(memory), 0);
+    std::vector<unsigned char> fifo;
+    target t { 0xFE, 0x20 };
+    t.map_memory(0x1000, memory.data(), memory.size());
+    t.map_memory(0x1'0000'0000, memory.data(), 16, false);
+    t.map_callbacks(
+        0x8000, 4,
+        [](uint64_t, unsigned char* data, std::size_t size, bool)
+        {
+            std::memset(data, 0xAB, size);
+            return status_t::success;
+        },
+        [&fifo](uint64_t, const unsigned char* data, std::size_t size, bool increment)
+        {
+            if (increment)
+                return status_t::general_error;
+            fifo.insert(std::end(fifo), data, data + size);
+            return status_t::success;
+        });
+    std::array<unsigned char, 8192> command;
+    std::array<unsigned char, 8192> reply;
+    GIVEN("a read command")
+    {
+        build_read_request(0xFE, 0x20, 0x67, 0x1010, 0x55AA, 32, command);
+        const auto size = t.handle(command.data(), 16, reply.data(), reply.size());
+        packet_view view { reply.data(), size };
+        REQUIRE(view.valid());
+        REQUIRE(view.kind() == packet_kind::read_reply);
+        REQUIRE(view.status() == status_t::success);
+        REQUIRE(view.destination_logical_address() == 0x67);
+        REQUIRE(view.source_logical_address() == 0xFE);
+        REQUIRE(view.transaction_id() == 0x55AA);
+        REQUIRE(std::equal(view.data(), view.data() + 32, memory.data() + 0x10));
+    }
+    GIVEN("a write command")
+    {
+        const std::vector<unsigned char> data(100, 0x11);
+        const auto command_size = *build_write_request(
+            0xFE, 0x20, 0x67, 0x1100, 1, data.data(), data.size(), command);
+        WHEN("it is valid")
+        {
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            packet_view view { reply.data(), size };
+            REQUIRE(view.kind() == packet_kind::write_reply);
+            REQUIRE(view.status() == status_t::success);
+            REQUIRE(std::equal(std::cbegin(data), std::cend(data), memory.data() + 0x100));
+        }
+        WHEN("its key is wrong")
+        {
+            command[3] = 0;
+            command[15] = spacewire::crc(command.data(), 15);
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::invalid_key);
+            REQUIRE(memory[0x100] == 0);
+        }
+        WHEN("it targets another logical address")
+        {
+            command[0] = 0x42;
+            command[15] = spacewire::crc(command.data(), 15);
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status()
+                == status_t::invalid_target_logical_address);
+        }
+        WHEN("its data CRC is wrong")
+        {
+            command[20] ^= 1;
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::invalid_data_crc);
+        }
+        WHEN("it is truncated")
+        {
+            const auto size
+                = t.handle(command.data(), command_size - 10, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::early_eop);
+            REQUIRE(memory[0x100] == 0);
+        }
+        WHEN("its header is corrupted")
+        {
+            command[10] ^= 1;
+            REQUIRE(t.handle(command.data(), command_size, reply.data(), reply.size()) == 0);
+        }
+        WHEN("it targets a read only region")
+        {
+            command[7] = 1;
+            command[8] = command[9] = command[10] = command[11] = 0;
+            command[15] = spacewire::crc(command.data(), 15);
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::not_authorised);
+        }
+        WHEN("it targets unmapped memory")
+        {
+            command[8] = 0x40;
+            command[15] = spacewire::crc(command.data(), 15);
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::not_authorised);
+        }
+        WHEN("it does not request an acknowledge")
+        {
+            command[2] &= ~0b00001000;
+            command[15] = spacewire::crc(command.data(), 15);
+            REQUIRE(t.handle(command.data(), command_size, reply.data(), reply.size()) == 0);
+            REQUIRE(memory[0x100] == 0x11);
+        }
+        WHEN("it does not increment the address")
+        {
+            command[2] &= ~0b00000100;
+            command[8] = 0;
+            command[9] = 0;
+            command[10] = 0x80;
+            command[11] = 0;
+            command[15] = spacewire::crc(command.data(), 15);
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::success);
+            REQUIRE(fifo == data);
+        }
+    }
+    GIVEN("a read-modify-write command")
+    {
+        const unsigned char data[] { 0xAA, 0xAA };
+        const unsigned char mask[] { 0xF0, 0x0F };
+        WHEN("it targets memory")
+        {
+            const auto command_size
+                = *build_rmw_command(0xFE, 0x20, 0x67, 0x1020, 5, data, mask, 2, command.data(),
+                    command.size());
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            packet_view view { reply.data(), size };
+            THEN("the target replies the previous value and writes the masked data")
+            {
+                REQUIRE(view.valid());
+                REQUIRE(view.kind() == packet_kind::rmw_reply);
+                REQUIRE(view.status() == status_t::success);
+                REQUIRE(view.data_length() == 2);
+                REQUIRE(view.data()[0] == 0x20);
+                REQUIRE(view.data()[1] == 0x21);
+                REQUIRE(memory[0x20] == 0xA0);
+                REQUIRE(memory[0x21] == 0x2A);
+            }
+        }
+        WHEN("its data length is odd")
+        {
+            auto command_size = *build_rmw_command(
+                0xFE, 0x20, 0x67, 0x1020, 5, data, mask, 1, command.data(), command.size());
+            command[14] = 3;
+            command[15] = spacewire::crc(command.data(), 15);
+            command[16 + 3] = spacewire::crc(command.data() + 16, 3);
+            command_size = 16 + 3 + 1;
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status()
+                == status_t::rmw_data_length_error);
+            REQUIRE(memory[0x20] == 0x20);
+        }
+        WHEN("it targets read only memory")
+        {
+            const auto command_size = *build_rmw_command(0xFE, 0x20, 0x67, 0x1'0000'0000, 5,
+                data, mask, 2, command.data(), command.size());
+            const auto size = t.handle(command.data(), command_size, reply.data(), reply.size());
+            REQUIRE(packet_view { reply.data(), size }.status() == status_t::not_authorised);
+        }
+    }
+    GIVEN("a write command without acknowledge")
+    {
+        const unsigned char data[] { 1, 2, 3, 4 };
+        const auto command_size = *build_write_command<options::none>(
+            0xFE, 0x20, 0x67, 0x1000, 6, data, 4, command.data(), command.size());
+        THEN("it is applied without reply")
+        {
+            REQUIRE(t.handle(command.data(), command_size, reply.data(), reply.size()) == 0);
+            REQUIRE(memory[0] == 4);
+        }
+    }
+    GIVEN("a command with a reply address")
+    {
+        std::vector<unsigned char> packet { 0xFE, 0x01, 0b01001101, 0x20, 0x00, 0x00, 0x03, 0x07,
+            0x67, 0x00, 0x01, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x04 };
+        packet.push_back(spacewire::crc(packet.data(), packet.size()));
+        const auto size = t.handle(packet.data(), packet.size(), reply.data(), reply.size());
+        THEN("the reply is prefixed with the reply address without its leading zeros")
+        {
+            REQUIRE(reply[0] == 0x03);
+            REQUIRE(reply[1] == 0x07);
+            packet_view view { reply.data() + 2, size - 2 };
+            REQUIRE(view.valid());
+            REQUIRE(view.kind() == packet_kind::read_reply);
+            REQUIRE(view.data()[0] == 0x00);
+            REQUIRE(view.data()[3] == 0x03);
+        }
+    }
+}
+
+SCENARIO("RMAP client and target over a link", "[]")
+{
+    using namespace spacewire::rmap;
+    auto memory = mapped_memory::anonymous(1 << 20);
+    REQUIRE(memory);
+    target t { 0xFE, 0 };
+    t.map_memory(0x4000'0000, memory.data(), memory.size());
+    auto [initiator, target_link] = spacewire::loopback_link::make_pair();
+    std::thread server { [&, &target_link = target_link]() { t.serve(target_link); } };
+    {
+        client c { initiator, client_config { 0xFE, 0, 0x20, 32, 1000ms, 5ms, 1 << 17 } };
+        std::vector<unsigned char> source(memory.size());
+        std::iota(std::begin(source), std::end(source), 7);
+        REQUIRE(write_region(c, 0x4000'0000, source.data(), source.size(),
+            transfer_config { 65536, 8, 0 })
+                    .ok());
+        std::vector<unsigned char> destination(memory.size());
+        REQUIRE(read_region(c, 0x4000'0000, destination.data(), destination.size(),
+            transfer_config { 65536, 8, 0 })
+                    .ok());
+        REQUIRE(destination == source);
+    }
+    target_link.close();
+    server.join();
+}
@@ -0,0 +1,133 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include <SpaceWirePP/transaction_table.hpp>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+SCENARIO("Transaction table", "[]")
+{
+    using namespace spacewire::rmap;
+    using table_t = transaction_table<int>;
+    const auto later = table_t::clock::now() + 1h;
+    GIVEN("a table of 4 transactions")
+    {
+        table_t table { 4 };
+        std::set<uint16_t> tids;
+        for (int i = 0; i < 4; i++)
+            tids.insert(*table.acquire(i, later));
+        REQUIRE(tids == std::set<uint16_t> { 0, 1, 2, 3 });
+        REQUIRE(table.in_flight() == 4);
+        REQUIRE_FALSE(table.acquire(10, later));
+        WHEN("a reply is received")
+        {
+            std::vector<unsigned char> reply { 0x67, 0x01, 0b00101100, 0, 0xFE, 0, 2, 0 };
+            auto context = table.complete(reply.data());
+            THEN("its context is returned and its TID released")
+            {
+                REQUIRE(context == 2);
+                REQUIRE(table.in_flight() == 3);
+                REQUIRE_FALSE(table.complete(reply.data()));
+                REQUIRE(table.acquire(11, later) == 2);
+            }
+        }
+        THEN("unknown TIDs are ignored") { REQUIRE_FALSE(table.complete(uint16_t { 1000 })); }
+        THEN("pending contexts can be looked up without completing them")
+        {
+            const int* context = table.find(3);
+            REQUIRE(context);
+            const int value = *context;
+            REQUIRE(table.complete(uint16_t { 3 }) == value);
+            REQUIRE_FALSE(table.find(3));
+            REQUIRE_FALSE(table.find(1000));
+        }
+    }
+    GIVEN("a table with expiring transactions")
+    {
+        table_t table { 4 };
+        const auto now = table_t::clock::now();
+        auto expiring = *table.acquire(1, now - 1s);
+        auto alive = *table.acquire(2, now + 1h);
+        std::vector<std::pair<uint16_t, int>> expired;
+        REQUIRE(table.expire(now, [&](uint16_t tid, int ctx) { expired.emplace_back(tid, ctx); })
+            == 1);
+        REQUIRE(expired == std::vector<std::pair<uint16_t, int>> { { expiring, 1 } });
+        REQUIRE(table.in_flight() == 1);
+        THEN("late replies are ignored") { REQUIRE_FALSE(table.complete(expiring)); }
+        THEN("expired TIDs are quarantined until the next sweep")
+        {
+            REQUIRE(table.acquire(3, later));
+            REQUIRE(table.acquire(4, later));
+            REQUIRE_FALSE(table.acquire(5, later));
+            table.expire(now, [](uint16_t, int) {});
+            REQUIRE(table.acquire(5, later) == expiring);
+        }
+        REQUIRE(table.complete(alive) == 2);
+    }
+    GIVEN("many producers and one receive thread")
+    {
+        table_t table { 64 };
+        constexpr int producers = 4;
+        constexpr int requests = 20000;
+        std::vector<std::atomic<bool>> done(producers * requests);
+        std::atomic<int> completed { 0 };
+        std::atomic<bool> stop { false };
+        std::atomic<bool> unmatched { false };
+        // stands for the link: producers push TIDs, the receiver pops them as replies
+        std::vector<std::atomic<int>> wire(64);
+        for (auto& slot : wire)
+            slot = -1;
+        std::thread receiver { [&]()
+            {
+                while (!stop)
+                {
+                    for (std::size_t tid = 0; tid < wire.size(); tid++)
+                    {
+                        if (wire[tid].load() != -1)
+                        {
+                            wire[tid] = -1;
+                            if (auto ctx = table.complete(static_cast<uint16_t>(tid)); ctx)
+                                done[*ctx] = true;
+                            else
+                                unmatched = true;
+                            ++completed;
+                        }
+                    }
+                }
+            } };
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++)
+            threads.emplace_back(
+                [&, p]()
+                {
+                    for (int i = 0; i < requests; i++)
+                    {
+                        std::optional<uint16_t> tid;
+                        while (!(tid = table.acquire(p * requests + i, later)))
+                            std::this_thread::yield();
+                        wire[*tid] = 1;
+                    }
+                });
+        for (auto& thread : threads)
+            thread.join();
+        while (completed != producers * requests)
+            std::this_thread::yield();
+        stop = true;
+        receiver.join();
+        REQUIRE_FALSE(unmatched);
+        REQUIRE(table.in_flight() == 0);
+        REQUIRE(std::all_of(std::cbegin(done), std::cend(done), [](auto& d) { return d.load(); }));
+    }
+}